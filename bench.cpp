@@ -0,0 +1,195 @@
+// End-to-end benchmark: generates a synthetic site (site_generator.h), then
+// times the crawl, search() for regular and phrase queries, and
+// processQueries() over a query file, reporting throughput, latency
+// percentiles and the peak resident set size of each phase.
+//
+//   ./nybench.exe [--dir DIR] [--pages N] [--depth D] [--branching B]
+//                 [--fanout F] [--vocabulary V] [--zipf S] [--words W]
+//                 [--seed X] [--queries Q] [--top-k K] [--threads T]
+
+#include "search.h"
+#include "site_generator.h"
+#include <sys/resource.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Latency below which 'fraction' of the sorted samples fall (nearest rank).
+static double percentile(const std::vector<double>& sorted, double fraction)
+{
+    if (sorted.empty()) return 0.0;
+    size_t rank = static_cast<size_t>(fraction * sorted.size() + 0.999999);
+    rank = std::min(std::max<size_t>(rank, 1), sorted.size());
+    return sorted[rank - 1];
+}
+
+// Start a new peak RSS measurement. Linux resets VmHWM to the current RSS
+// when "5" is written to clear_refs; elsewhere the peak covers the whole run.
+static void resetPeakMemory()
+{
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    if (clearRefs.is_open()) {
+        clearRefs << "5";
+    }
+}
+
+// Peak RSS in MB since the last resetPeakMemory().
+static double peakMemoryMB()
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "VmHWM:") == 0) {
+            return std::atof(line.c_str() + 6) / 1024.0;
+        }
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0;
+}
+
+// Times search() on each query, the result cache disabled so every call ranks.
+static void benchSearch(const Search& engine, const char* name, const std::vector<std::string>& queries, bool isPhraseSearch, size_t topK)
+{
+    resetPeakMemory();
+    std::vector<double> latencies;
+    size_t results = 0;
+    Clock::time_point start = Clock::now();
+    for (const std::string& query : queries) {
+        Clock::time_point queryStart = Clock::now();
+        results += engine.search(query, isPhraseSearch, topK).size();
+        latencies.push_back(secondsSince(queryStart) * 1000.0);
+    }
+    double seconds = secondsSince(start);
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << name << ": " << queries.size() << " queries in " << seconds << " s, "
+              << queries.size() / seconds << " queries/s, "
+              << static_cast<double>(results) / std::max<size_t>(1, queries.size()) << " results each; latency ms p50 "
+              << percentile(latencies, 0.50) << ", p90 " << percentile(latencies, 0.90) << ", p99 "
+              << percentile(latencies, 0.99) << ", max " << (latencies.empty() ? 0.0 : latencies.back())
+              << "; peak RSS " << peakMemoryMB() << " MB" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    SiteOptions options;
+    std::string directory = "bench_site";
+    size_t queryCount = 200;
+    size_t topK = 0;
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (arg == "--dir") {
+            directory = value;
+        } else if (arg == "--pages") {
+            options.pages = std::strtoul(value.c_str(), nullptr, 10);
+        } else if (arg == "--depth") {
+            options.depth = static_cast<unsigned>(std::atoi(value.c_str()));
+        } else if (arg == "--branching") {
+            options.branching = static_cast<unsigned>(std::atoi(value.c_str()));
+        } else if (arg == "--fanout") {
+            options.fanout = static_cast<unsigned>(std::max(1, std::atoi(value.c_str())));
+        } else if (arg == "--vocabulary") {
+            options.vocabulary = std::max(1ul, std::strtoul(value.c_str(), nullptr, 10));
+        } else if (arg == "--zipf") {
+            options.zipf = std::atof(value.c_str());
+        } else if (arg == "--words") {
+            options.wordsPerPage = std::max(1ul, std::strtoul(value.c_str(), nullptr, 10));
+        } else if (arg == "--seed") {
+            options.seed = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (arg == "--queries") {
+            queryCount = std::max(1ul, std::strtoul(value.c_str(), nullptr, 10));
+        } else if (arg == "--top-k") {
+            topK = static_cast<size_t>(std::max(0, std::atoi(value.c_str())));
+        } else if (arg == "--threads") {
+            threads = static_cast<unsigned>(std::max(1, std::atoi(value.c_str())));
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--dir DIR] [--pages N] [--depth D] [--branching B] [--fanout F]" << std::endl
+                      << "       [--vocabulary V] [--zipf S] [--words W] [--seed X] [--queries Q] [--top-k K] [--threads T]" << std::endl;
+            return 1;
+        }
+    }
+
+    try {
+        std::cout << std::fixed << std::setprecision(2);
+
+        Clock::time_point start = Clock::now();
+        GeneratedSite site = generateSite(directory, options);
+        std::cout << "Generate: " << site.pages << " pages, " << site.bytes / 1e6 << " MB in "
+                  << secondsSince(start) << " s" << std::endl;
+
+        Search engine;
+        engine.setResultCacheSize(0);
+        unsigned crawlThreads = threads;
+        resetPeakMemory();
+        start = Clock::now();
+        engine.crawl(site.seedPath, crawlThreads);
+        double seconds = secondsSince(start);
+        std::cout << "Crawl (" << crawlThreads << " threads): " << seconds << " s, " << site.pages / seconds
+                  << " pages/s, " << site.bytes / seconds / 1e6 << " MB/s; peak RSS " << peakMemoryMB() << " MB" << std::endl;
+
+        // Regular queries of one to three words among the most frequent
+        // tenth of the vocabulary; phrase queries from word pairs the generator wrote.
+        std::vector<std::string> regular;
+        std::vector<std::string> phrases;
+        for (size_t i = 0; i < queryCount; i++) {
+            size_t words = 1 + i % 3;
+            std::string query;
+            for (size_t w = 0; w < words; w++) {
+                size_t rank = (i * 7919 + w * 104729) % (site.vocabulary.size() / 10 + 1);
+                query += (w > 0 ? " " : "") + site.vocabulary[rank];
+            }
+            regular.push_back(query);
+            if (!site.phrases.empty()) {
+                phrases.push_back("\"" + site.phrases[i % site.phrases.size()] + "\"");
+            }
+        }
+        benchSearch(engine, "Regular search", regular, false, topK);
+        benchSearch(engine, "Phrase search", phrases, true, topK);
+
+        // processQueries() writes out<N>.txt to the working directory.
+        std::string queryFile = directory + "/queries.txt";
+        std::ofstream out(queryFile);
+        for (size_t i = 0; i < queryCount; i++) {
+            out << regular[i] << "\n";
+            if (i < phrases.size()) {
+                out << phrases[i] << "\n";
+            }
+        }
+        out.close();
+        if (!out || chdir(directory.c_str()) != 0) {
+            throw std::runtime_error("cannot write queries to " + directory);
+        }
+        size_t lines = regular.size() + phrases.size();
+        resetPeakMemory();
+        start = Clock::now();
+        engine.processQueries("queries.txt", topK, threads);
+        seconds = secondsSince(start);
+        std::cout << "processQueries (" << threads << " threads): " << lines << " queries in " << seconds << " s, "
+                  << lines / seconds << " queries/s; peak RSS " << peakMemoryMB() << " MB" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,118 @@
+#include "crawl_frontier.h"
+#include <functional>
+
+// ===================================================
+// CONCURRENT URL SET
+// ===================================================
+
+ConcurrentURLSet::ConcurrentURLSet() : shards(new Shard[SHARDS]) {}
+
+ConcurrentURLSet::Shard& ConcurrentURLSet::shardFor(const std::string& url) const
+{
+    return shards[std::hash<std::string>()(url) % SHARDS];
+}
+
+bool ConcurrentURLSet::insert(const std::string& url)
+{
+    Shard& shard = shardFor(url);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    return shard.urls.insert(url).second;
+}
+
+bool ConcurrentURLSet::contains(const std::string& url) const
+{
+    Shard& shard = shardFor(url);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    return shard.urls.find(url) != shard.urls.end();
+}
+
+void ConcurrentURLSet::clear()
+{
+    for (size_t i = 0; i < SHARDS; i++) {
+        std::lock_guard<std::mutex> guard(shards[i].lock);
+        shards[i].urls.clear();
+    }
+}
+
+// ===================================================
+// WORK-STEALING FRONTIER
+// ===================================================
+
+CrawlFrontier::CrawlFrontier(size_t workers) : pending(0), available(0), sleepers(0)
+{
+    for (size_t i = 0; i < workers; i++) {
+        queues.push_back(std::unique_ptr<Queue>(new Queue()));
+    }
+}
+
+void CrawlFrontier::push(size_t worker, const std::string& url)
+{
+    // Count the URL before it becomes visible, so pop() never sees an empty
+    // frontier with pending == 0 while work is still in flight, and never
+    // takes it (decrementing 'available') before it was counted.
+    pending++;
+    available++;
+    {
+        Queue& queue = *queues[worker];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        queue.urls.push_back(url);
+    }
+    // A sleeper counts itself before it checks 'available' under idleLock,
+    // so either it sees this URL or it is waiting by the time we notify.
+    if (sleepers.load() > 0) {
+        std::lock_guard<std::mutex> guard(idleLock);
+        wake.notify_one();
+    }
+}
+
+bool CrawlFrontier::pop(size_t worker, std::string& url)
+{
+    while (true) {
+        // Own queue first, newest URL first.
+        {
+            Queue& own = *queues[worker];
+            std::lock_guard<std::mutex> guard(own.lock);
+            if (!own.urls.empty()) {
+                url.swap(own.urls.back());
+                own.urls.pop_back();
+                available--;
+                return true;
+            }
+        }
+
+        // Otherwise steal the oldest URL from another worker.
+        for (size_t i = 1; i < queues.size(); i++) {
+            Queue& victim = *queues[(worker + i) % queues.size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.urls.empty()) {
+                url.swap(victim.urls.front());
+                victim.urls.pop_front();
+                available--;
+                return true;
+            }
+        }
+
+        // Someone is still parsing a page and may push more links: sleep
+        // until a URL shows up or the last one is done. A URL that shows up
+        // can be stolen before we rescan, so only the end of the crawl ends
+        // the loop.
+        std::unique_lock<std::mutex> idle(idleLock);
+        sleepers++;
+        wake.wait(idle, [this]()
+        {
+            return available.load() > 0 || pending.load() == 0;
+        });
+        sleepers--;
+        if (pending.load() == 0) {
+            return false;
+        }
+    }
+}
+
+void CrawlFrontier::done()
+{
+    if (--pending == 0) {
+        std::lock_guard<std::mutex> guard(idleLock);
+        wake.notify_all();
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef CRAWL_FRONTIER_H
+#define CRAWL_FRONTIER_H
+
+#include <string>
+#include <unordered_set>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+
+// Set of URLs the crawler has already claimed. Split into independently
+// locked shards so crawl threads rarely contend on the same lock.
+class ConcurrentURLSet
+{
+public:
+    ConcurrentURLSet();
+
+    // Returns true if the URL was not in the set (the caller now owns it).
+    bool insert(const std::string& url);
+    bool contains(const std::string& url) const;
+    void clear();
+
+private:
+    static const size_t SHARDS = 64;
+    struct Shard
+    {
+        mutable std::mutex lock;
+        std::unordered_set<std::string> urls;
+    };
+    std::unique_ptr<Shard[]> shards;
+
+    Shard& shardFor(const std::string& url) const;
+};
+
+// Work-stealing queue of URLs waiting to be crawled. Each worker pushes the
+// links it discovers onto its own deque and pops from the back (so a worker
+// keeps following the branch it is on); an idle worker steals from the front
+// of another worker's deque. A worker that finds nothing to take sleeps until
+// a URL is pushed or the crawl is finished.
+class CrawlFrontier
+{
+public:
+    explicit CrawlFrontier(size_t workers);
+
+    void push(size_t worker, const std::string& url);
+
+    // Fetch the next URL for 'worker'. Returns false once every queue is
+    // empty and no worker is still processing a URL (the crawl is finished).
+    bool pop(size_t worker, std::string& url);
+
+    // Mark a URL returned by pop() as fully processed (its links pushed).
+    void done();
+
+private:
+    struct Queue
+    {
+        std::mutex lock;
+        std::deque<std::string> urls;
+    };
+    std::vector<std::unique_ptr<Queue> > queues;
+    std::atomic<size_t> pending;   // pushed but not yet done()
+    std::atomic<size_t> available; // pushed but not yet popped
+    std::atomic<size_t> sleepers;  // workers waiting in pop()
+    std::mutex idleLock;
+    std::condition_variable wake;
+};
+
+#endif // CRAWL_FRONTIER_H
@@ -0,0 +1,383 @@
+#include "document_table.h"
+#include "text_search.h"
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstdio>
+#include <set>
+
+void DocumentTable::clear()
+{
+    urls.clear();
+    titles.clear();
+    descriptions.clear();
+    files.clear();
+    bodyRanges.clear();
+    bodyLength.clear();
+    sentenceEnds.clear();
+    links.clear();
+    terms.clear();
+    linkTargets.clear();
+    fileStates.clear();
+    hrefs.clear();
+    ids.clear();
+    contentStart.clear();
+    contentText.clear();
+    contentFile.close();
+    lowerShadow.clear();
+    lowerText.clear();
+    keptContent.clear();
+}
+
+DocId DocumentTable::add(const std::string& url)
+{
+    DocId doc = static_cast<DocId>(urls.size());
+    urls.push_back(url);
+    titles.emplace_back();
+    descriptions.emplace_back();
+    files.emplace_back();
+    bodyRanges.emplace_back();
+    bodyLength.push_back(0);
+    sentenceEnds.emplace_back();
+    terms.emplace_back();
+    linkTargets.emplace_back();
+    fileStates.push_back(FileState());
+    hrefs.emplace_back();
+    lowerShadow.push_back(nullptr);
+    ids[url] = doc;
+    return doc;
+}
+
+DocId DocumentTable::addCopy(const DocumentTable& source, DocId doc)
+{
+    DocId copy = add(source.urls[doc]);
+    titles[copy] = source.titles[doc];
+    descriptions[copy] = source.descriptions[doc];
+    files[copy].borrow(source.html(doc));
+    lowerShadow[copy] = source.lowerShadow[doc];
+    bodyRanges[copy] = source.bodyRanges[doc];
+    bodyLength[copy] = source.bodyLength[doc];
+    sentenceEnds[copy] = source.sentenceEnds[doc];
+    if (doc < source.fileStates.size()) {
+        fileStates[copy] = source.fileStates[doc];
+        hrefs[copy] = source.hrefs[doc];
+    }
+    return copy;
+}
+
+void DocumentTable::keepContent(DocumentTable& source)
+{
+    keptContent.push_back(std::move(source.contentFile));
+}
+
+DocId DocumentTable::find(const std::string& url) const
+{
+    std::unordered_map<std::string, DocId>::const_iterator it = ids.find(url);
+    if (it == ids.end()) {
+        return NO_DOC;
+    }
+    return it->second;
+}
+
+void DocumentTable::bodyText(DocId doc, std::string& out) const
+{
+    std::string_view raw = html(doc);
+    out.clear();
+    out.reserve(bodyLength[doc]);
+    for (const TextRange& range : bodyRanges[doc]) {
+        out.append(raw.data() + range.offset, range.length);
+    }
+}
+
+// Move every element of 'column' to its new position.
+template <typename T>
+static void permute(std::vector<T>& column, const std::vector<DocId>& order)
+{
+    std::vector<T> sorted;
+    sorted.reserve(column.size());
+    for (DocId old : order) {
+        sorted.push_back(std::move(column[old]));
+    }
+    column.swap(sorted);
+}
+
+void DocumentTable::finalize()
+{
+    // order[newId] = provisional id
+    std::vector<DocId> order(urls.size());
+    for (DocId doc = 0; doc < order.size(); doc++) {
+        order[doc] = doc;
+    }
+    std::sort(order.begin(), order.end(), [this](DocId a, DocId b)
+    {
+        return urls[a] < urls[b];
+    });
+
+    permute(urls, order);
+    permute(titles, order);
+    permute(descriptions, order);
+    permute(files, order);
+    permute(bodyRanges, order);
+    permute(bodyLength, order);
+    permute(sentenceEnds, order);
+    permute(terms, order);
+    permute(linkTargets, order);
+    permute(fileStates, order);
+    permute(hrefs, order);
+    permute(lowerShadow, order);
+    for (DocId doc = 0; doc < urls.size(); doc++) {
+        ids[urls[doc]] = doc;
+    }
+
+    std::vector<uint32_t> outDegree(urls.size(), 0);
+    std::vector<std::vector<DocId> > incoming(urls.size());
+    std::vector<std::vector<DocId> > outgoing(urls.size());
+    for (DocId doc = 0; doc < urls.size(); doc++) {
+        std::set<std::string> distinctTargets;
+        for (const std::string& target : linkTargets[doc]) {
+            DocId targetDoc = find(target);
+            // A page linking to itself counts as its own backlink but not as
+            // one of its outgoing links.
+            if (targetDoc != NO_DOC) {
+                incoming[targetDoc].push_back(doc);
+            }
+            if (target != urls[doc]) {
+                distinctTargets.insert(target);
+                if (targetDoc != NO_DOC) {
+                    outgoing[doc].push_back(targetDoc);
+                }
+            }
+        }
+        outDegree[doc] = static_cast<uint32_t>(distinctTargets.size());
+        std::vector<std::string>().swap(linkTargets[doc]);
+    }
+
+    // Sources were visited in increasing order, so incoming lists are sorted;
+    // both kinds of list may still hold repeats of the same link.
+    for (DocId doc = 0; doc < urls.size(); doc++) {
+        incoming[doc].erase(std::unique(incoming[doc].begin(), incoming[doc].end()), incoming[doc].end());
+        std::sort(outgoing[doc].begin(), outgoing[doc].end());
+        outgoing[doc].erase(std::unique(outgoing[doc].begin(), outgoing[doc].end()), outgoing[doc].end());
+    }
+    links.build(incoming, outgoing, outDegree);
+
+    // Documents copied by addCopy() already have their shadow.
+    size_t foldedLength = 0;
+    for (DocId doc = 0; doc < urls.size(); doc++) {
+        if (lowerShadow[doc] == nullptr) {
+            foldedLength += html(doc).size();
+        }
+    }
+    std::vector<char> folded(foldedLength);
+    size_t offset = 0;
+    for (DocId doc = 0; doc < urls.size(); doc++) {
+        if (lowerShadow[doc] == nullptr) {
+            std::string_view raw = html(doc);
+            foldCase(raw.data(), raw.size(), folded.data() + offset);
+            lowerShadow[doc] = folded.data() + offset;
+            offset += raw.size();
+        }
+    }
+    // The vector's buffer moves into lowerText, so the pointers stay valid.
+    lowerText.assign(std::move(folded));
+}
+
+// ===================================================
+// PERSISTENCE
+// ===================================================
+
+// A list of lists is stored flat: u64 start offsets, then every element.
+template <typename T>
+static void writeNested(IndexFileWriter& out, const std::vector<std::vector<T> >& lists)
+{
+    std::vector<uint64_t> starts(1, 0);
+    for (const std::vector<T>& list : lists) {
+        starts.push_back(starts.back() + list.size());
+    }
+    out.writeArray(starts);
+    out.beginArray(starts.back());
+    for (const std::vector<T>& list : lists) {
+        out.append(list.data(), list.size());
+    }
+    out.endArray();
+}
+
+template <typename T>
+static void readNested(IndexFileReader& in, std::vector<std::vector<T> >& lists, size_t expected)
+{
+    size_t startCount, total;
+    const uint64_t* starts = in.readArray<uint64_t>(startCount);
+    const T* values = in.readArray<T>(total);
+    if (startCount != expected + 1 || starts[0] != 0 || starts[expected] != total) {
+        in.fail("list table does not match the document count");
+    }
+    lists.assign(expected, std::vector<T>());
+    for (size_t i = 0; i < expected; i++) {
+        if (starts[i] > starts[i + 1]) {
+            in.fail("list offsets out of order");
+        }
+        lists[i].assign(values + starts[i], values + starts[i + 1]);
+    }
+}
+
+uint64_t DocumentTable::fingerprint() const
+{
+    Checksum checksum;
+    for (DocId doc = 0; doc < size(); doc++) {
+        std::string_view raw = html(doc);
+        uint64_t lengths[2] = { urls[doc].size(), raw.size() };
+        checksum.update(lengths, sizeof(lengths));
+        checksum.update(urls[doc].data(), urls[doc].size());
+        checksum.update(raw.data(), raw.size());
+    }
+    return checksum.value();
+}
+
+void DocumentTable::save(const std::string& directory, uint64_t build) const
+{
+    IndexFileWriter documentsOut(indexFilePath(directory, SECTION_DOCUMENTS), SECTION_DOCUMENTS, build);
+    documentsOut.writeStrings(urls);
+    documentsOut.writeStrings(titles);
+    documentsOut.writeStrings(descriptions);
+    documentsOut.writeArray(bodyLength);
+    writeNested(documentsOut, bodyRanges);
+    writeNested(documentsOut, sentenceEnds);
+    documentsOut.finish();
+
+    links.save(directory, build);
+
+    IndexFileWriter contentOut(indexFilePath(directory, SECTION_CONTENT), SECTION_CONTENT, build);
+    std::vector<uint64_t> starts(1, 0);
+    for (DocId doc = 0; doc < size(); doc++) {
+        starts.push_back(starts.back() + html(doc).size());
+    }
+    contentOut.writeArray(starts);
+    contentOut.beginArray(starts.back());
+    for (DocId doc = 0; doc < size(); doc++) {
+        std::string_view raw = html(doc);
+        contentOut.append(raw.data(), raw.size());
+    }
+    contentOut.endArray();
+    contentOut.beginArray(starts.back());
+    for (DocId doc = 0; doc < size(); doc++) {
+        contentOut.append(lowerShadow[doc], html(doc).size());
+    }
+    contentOut.endArray();
+    contentOut.finish();
+}
+
+uint64_t DocumentTable::load(const std::string& directory)
+{
+    clear();
+
+    MappedFile documentsFile;
+    IndexFileReader documentsIn(documentsFile, indexFilePath(directory, SECTION_DOCUMENTS), SECTION_DOCUMENTS);
+    uint64_t build = documentsIn.build();
+    documentsIn.readStrings(urls);
+    documentsIn.readStrings(titles);
+    documentsIn.readStrings(descriptions);
+    documentsIn.readArray(bodyLength);
+    size_t count = urls.size();
+    if (titles.size() != count || descriptions.size() != count || bodyLength.size() != count) {
+        documentsIn.fail("document columns differ in length");
+    }
+    readNested(documentsIn, bodyRanges, count);
+    readNested(documentsIn, sentenceEnds, count);
+    documentsIn.finish();
+    for (DocId doc = 0; doc < count; doc++) {
+        for (size_t i = 0; i < sentenceEnds[doc].size(); i++) {
+            if (sentenceEnds[doc][i] >= bodyLength[doc] || (i > 0 && sentenceEnds[doc][i] <= sentenceEnds[doc][i - 1])) {
+                documentsIn.fail("bad sentence offsets");
+            }
+        }
+    }
+
+    links.load(directory, count, build);
+
+    IndexFileReader contentIn(contentFile, indexFilePath(directory, SECTION_CONTENT), SECTION_CONTENT);
+    contentIn.expectBuild(build);
+    contentIn.readArray(contentStart);
+    contentIn.readArray(contentText);
+    contentIn.readArray(lowerText);
+    contentIn.finish();
+    if (contentStart.size() != count + 1 || contentStart[count] != contentText.size()) {
+        contentIn.fail("content table does not match the document count");
+    }
+    if (lowerText.size() != contentText.size()) {
+        contentIn.fail("lowercase shadow does not match the content");
+    }
+    // The shadows have the same lengths, so they share the content offsets.
+    lowerShadow.resize(count);
+    for (DocId doc = 0; doc < count; doc++) {
+        if (contentStart[doc] > contentStart[doc + 1]) {
+            contentIn.fail("content offsets out of order");
+        }
+        lowerShadow[doc] = lowerText.data() + contentStart[doc];
+        uint64_t length = contentStart[doc + 1] - contentStart[doc];
+        for (const TextRange& range : bodyRanges[doc]) {
+            if (static_cast<uint64_t>(range.offset) + range.length > length) {
+                contentIn.fail("body range outside its document");
+            }
+        }
+    }
+
+    for (DocId doc = 0; doc < count; doc++) {
+        ids[urls[doc]] = doc;
+    }
+    return build;
+}
+
+void DocumentTable::saveCrawlState(const std::string& directory, const std::string& seed, uint64_t build) const
+{
+    std::string path = indexFilePath(directory, SECTION_CRAWL);
+    if (fileStates.size() != size()) {
+        // A crawl file left from an earlier crawl would not describe this one.
+        std::remove(path.c_str());
+        return;
+    }
+    IndexFileWriter crawlOut(path, SECTION_CRAWL, build);
+    crawlOut.writeStrings(std::vector<std::string>(1, seed));
+    crawlOut.writeArray(fileStates);
+    std::vector<uint64_t> starts(1, 0);
+    std::vector<std::string> flat;
+    for (const std::vector<std::string>& list : hrefs) {
+        flat.insert(flat.end(), list.begin(), list.end());
+        starts.push_back(flat.size());
+    }
+    crawlOut.writeArray(starts);
+    crawlOut.writeStrings(flat);
+    crawlOut.finish();
+}
+
+bool DocumentTable::loadCrawlState(const std::string& directory, std::string& seed, uint64_t build)
+{
+    std::string path = indexFilePath(directory, SECTION_CRAWL);
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+    MappedFile crawlFile;
+    IndexFileReader crawlIn(crawlFile, path, SECTION_CRAWL);
+    crawlIn.expectBuild(build);
+    std::vector<std::string> seeds;
+    std::vector<uint64_t> starts;
+    std::vector<std::string> flat;
+    crawlIn.readStrings(seeds);
+    crawlIn.readArray(fileStates);
+    crawlIn.readArray(starts);
+    crawlIn.readStrings(flat);
+    crawlIn.finish();
+    size_t count = size();
+    if (seeds.size() != 1 || fileStates.size() != count || starts.size() != count + 1 || starts[0] != 0 ||
+        starts[count] != flat.size()) {
+        crawlIn.fail("crawl state does not match the document count");
+    }
+    seed = seeds[0];
+    hrefs.assign(count, std::vector<std::string>());
+    for (size_t i = 0; i < count; i++) {
+        if (starts[i] > starts[i + 1]) {
+            crawlIn.fail("href offsets out of order");
+        }
+        hrefs[i].assign(flat.begin() + starts[i], flat.begin() + starts[i + 1]);
+    }
+    return true;
+}
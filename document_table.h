@@ -0,0 +1,128 @@
+#ifndef DOCUMENT_TABLE_H
+#define DOCUMENT_TABLE_H
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "inverted_index.h"
+#include "html_tokenizer.h"
+#include "mapped_file.h"
+#include "index_file.h"
+#include "link_graph.h"
+
+// What a crawled file looked like when it was read, so a later recrawl can
+// tell whether it changed (see Search::updateIndex).
+struct FileState
+{
+    int64_t modified; // modification time, nanoseconds since the epoch
+    uint64_t size;
+    uint64_t hash;    // Checksum of the contents
+};
+
+// Everything known about the crawled documents, stored as parallel arrays
+// indexed by DocId. URLs are only needed to get in (crawl) and out (output
+// files); ranking and search work on DocIds alone. Raw HTML stays in the
+// memory-mapped files and body text is kept as ranges into it, so the heap
+// only holds per-document metadata. A table loaded from an index directory
+// reads raw HTML from the index's mapped content file instead. Every
+// document also has a lowercase shadow of its HTML (see text_search.h),
+// folded once by finalize() and stored in the index, so case-insensitive
+// searches never fold a document per query.
+struct DocumentTable
+{
+    static const DocId NO_DOC = static_cast<DocId>(-1);
+
+    std::vector<std::string> urls;
+    std::vector<std::string> titles;
+    std::vector<std::string> descriptions;
+    std::vector<MappedFile> files;                 // raw HTML, mapped
+    std::vector<std::vector<TextRange> > bodyRanges; // <body> text with tags stripped
+    std::vector<uint32_t> bodyLength;
+    std::vector<std::vector<uint32_t> > sentenceEnds; // offset of every '.' in the body text
+
+    // Link graph between the documents, built by finalize().
+    LinkGraph links;
+
+    // Crawl-time data, released by finalize()/buildIndex().
+    std::vector<std::vector<TermSpan> > terms;         // raw HTML tokens awaiting indexing
+    std::vector<std::vector<std::string> > linkTargets; // resolved hrefs, in document order
+
+    // Kept for recrawls: the file each document was read from, and its local
+    // hrefs as written (linkTargets are re-resolved from them). Empty in a
+    // table loaded by load() until loadCrawlState() reads them.
+    std::vector<FileState> fileStates;
+    std::vector<std::vector<std::string> > hrefs;
+
+    void clear();
+    size_t size() const { return urls.size(); }
+
+    std::string_view html(DocId doc) const
+    {
+        if (doc < files.size()) return files[doc].view();
+        return std::string_view(contentText.data() + contentStart[doc], contentStart[doc + 1] - contentStart[doc]);
+    }
+
+    // The raw HTML with ASCII letters lowercased, at the same offsets.
+    std::string_view lowerHtml(DocId doc) const { return std::string_view(lowerShadow[doc], html(doc).size()); }
+
+    // Assemble a document's body text from its ranges into 'out'.
+    void bodyText(DocId doc, std::string& out) const;
+
+    // Append a document as it is crawled; returns its provisional DocId.
+    DocId add(const std::string& url);
+
+    // Append a copy of document 'doc' of a table loaded from an index,
+    // without its link targets; returns its provisional DocId. Its raw HTML
+    // and lowercase shadow are not copied but read from the source's content
+    // file, which keepContent() hands over to this table.
+    DocId addCopy(const DocumentTable& source, DocId doc);
+
+    // Keep the content file of 'source' mapped for as long as this table, so
+    // documents addCopy() took from it stay valid once 'source' is gone.
+    void keepContent(DocumentTable& source);
+
+    // DocId of a URL, or NO_DOC if it was not crawled.
+    DocId find(const std::string& url) const;
+
+    // Renumber documents into sorted URL order, resolve linkTargets into the
+    // DocId link graph and fold the lowercase shadows of the documents that
+    // do not have one yet.
+    void finalize();
+
+    // Checksum of every document's URL and raw HTML. Everything an index
+    // holds follows from those, so it serves as the build id of the index.
+    uint64_t fingerprint() const;
+
+    // Write the finalized table (documents, link graph and raw HTML) to an
+    // index directory under a build id, or load it back with the HTML left
+    // in the mapping; load() returns the build id and rejects a link graph
+    // or content file of another build.
+    void save(const std::string& directory, uint64_t build) const;
+    uint64_t load(const std::string& directory);
+
+    // The same for the crawl state (seed, fileStates and hrefs). A table
+    // without it (fileStates empty) removes the directory's crawl file
+    // instead; loadCrawlState() returns false if there is none.
+    void saveCrawlState(const std::string& directory, const std::string& seed, uint64_t build) const;
+    bool loadCrawlState(const std::string& directory, std::string& seed, uint64_t build);
+
+private:
+    std::unordered_map<std::string, DocId> ids;
+
+    // Raw HTML of a loaded table: document d is contentText[contentStart[d],
+    // contentStart[d + 1]).
+    StoredArray<uint64_t> contentStart;
+    StoredArray<char> contentText;
+    MappedFile contentFile;
+
+    // Lowercase shadows: document d's starts at lowerShadow[d] and is as long
+    // as its HTML. They point into lowerText (folded by finalize(), or mapped
+    // by load()), or into a content file in keptContent for documents added
+    // by addCopy().
+    std::vector<const char*> lowerShadow;
+    StoredArray<char> lowerText;
+    std::vector<MappedFile> keptContent;
+};
+
+#endif // DOCUMENT_TABLE_H
@@ -0,0 +1,237 @@
+#include "html_tokenizer.h"
+#include <cctype>
+#include <cstring>
+
+// ===================================================
+// HELPERS
+// ===================================================
+
+static bool startsWithAt(std::string_view content, size_t pos, const char* literal)
+{
+    size_t length = std::strlen(literal);
+    return pos + length <= content.size() && content.compare(pos, length, literal) == 0;
+}
+
+static bool isSpace(char c)
+{
+    return std::isspace(static_cast<unsigned char>(c)) != 0;
+}
+
+static bool isWordChar(char c)
+{
+    return std::isalnum(static_cast<unsigned char>(c)) != 0;
+}
+
+// Append the body character at content[pos], extending the current raw
+// range and the current body word (or closing the word).
+static void appendBodyChar(ParsedPage& page, char c, size_t pos, bool& inWord)
+{
+    if (!page.bodyRanges.empty() &&
+        page.bodyRanges.back().offset + page.bodyRanges.back().length == pos) {
+        page.bodyRanges.back().length++;
+    } else {
+        TextRange range;
+        range.offset = static_cast<uint32_t>(pos);
+        range.length = 1;
+        page.bodyRanges.push_back(range);
+    }
+
+    if (isWordChar(c)) {
+        if (!inWord) {
+            TermSpan span;
+            span.offset = static_cast<uint32_t>(page.body.size());
+            span.length = 0;
+            page.bodyTerms.push_back(span);
+            inWord = true;
+        }
+        page.bodyTerms.back().length++;
+    } else {
+        inWord = false;
+    }
+    page.body.push_back(c);
+}
+
+// ===================================================
+// TAG MATCHERS
+// ===================================================
+
+// Matches <meta\s+name="description"\s+content="([^"]+)" starting at pos.
+bool HtmlTokenizer::matchDescription(std::string_view content, size_t pos, std::string& description)
+{
+    size_t j = pos + 5; // past "<meta"
+    if (j >= content.size() || !isSpace(content[j])) return false;
+    while (j < content.size() && isSpace(content[j])) j++;
+
+    if (!startsWithAt(content, j, "name=\"description\"")) return false;
+    j += 18;
+    if (j >= content.size() || !isSpace(content[j])) return false;
+    while (j < content.size() && isSpace(content[j])) j++;
+
+    if (!startsWithAt(content, j, "content=\"")) return false;
+    j += 9;
+    size_t close = content.find('"', j);
+    if (close == std::string_view::npos || close == j) return false;
+
+    description.assign(content.substr(j, close - j));
+    return true;
+}
+
+// Matches <a\s+[^>]*href\s*=\s*['"]([^'"]+)['"][^>]*> starting at pos. The
+// greedy [^>]* means the last "href" before the tag's first '>' that can
+// complete the match wins, so candidates are tried right to left.
+bool HtmlTokenizer::matchLink(std::string_view content, size_t pos, std::string& link, size_t& end)
+{
+    size_t firstClose = content.find('>', pos + 2);
+    if (firstClose == std::string_view::npos || firstClose < pos + 7) return false;
+
+    size_t candidate = content.rfind("href", firstClose - 4);
+    while (candidate != std::string_view::npos && candidate >= pos + 3) {
+        size_t j = candidate + 4;
+        while (j < content.size() && isSpace(content[j])) j++;
+        if (j < content.size() && content[j] == '=') {
+            j++;
+            while (j < content.size() && isSpace(content[j])) j++;
+            if (j < content.size() && (content[j] == '"' || content[j] == '\'')) {
+                size_t valueStart = ++j;
+                while (j < content.size() && content[j] != '"' && content[j] != '\'') j++;
+                if (j < content.size() && j > valueStart) {
+                    size_t tagEnd = content.find('>', j + 1);
+                    if (tagEnd != std::string_view::npos) {
+                        link.assign(content.substr(valueStart, j - valueStart));
+                        end = tagEnd + 1;
+                        return true;
+                    }
+                }
+            }
+        }
+        if (candidate == 0) break;
+        candidate = content.rfind("href", candidate - 1);
+    }
+    return false;
+}
+
+// Tag-strip content[begin, end) into page.body (used when there is no usable <body>).
+void HtmlTokenizer::stripTags(std::string_view content, size_t begin, size_t end, ParsedPage& page)
+{
+    bool inTag = false;
+    bool inWord = false;
+    for (size_t i = begin; i < end; i++) {
+        char c = content[i];
+        if (c == '<') {
+            inTag = true;
+        } else if (c == '>') {
+            inTag = false;
+        } else if (!inTag) {
+            appendBodyChar(page, c, i, inWord);
+        }
+    }
+}
+
+// ===================================================
+// SINGLE-PASS PARSE
+// ===================================================
+
+void HtmlTokenizer::parse(std::string_view content, ParsedPage& page)
+{
+    page.title.clear();
+    page.description.clear();
+    page.body.clear();
+    page.bodyRanges.clear();
+    page.links.clear();
+    page.terms.clear();
+    page.bodyTerms.clear();
+
+    const size_t npos = std::string_view::npos;
+    size_t titleStart = npos, titleEnd = npos;
+    size_t bodyTag = npos, bodyStart = npos, bodyEnd = npos;
+    bool foundDescription = false;
+    size_t linkResume = 0;
+
+    // Body stripping state: active from just past the <body ...> tag until the
+    // first </body> (or to the end of file if </body> came earlier).
+    bool collecting = false;
+    bool inTag = false;
+    bool inBodyWord = false;
+
+    bool inTerm = false;
+    size_t termStart = 0;
+
+    const size_t size = content.size();
+    for (size_t i = 0; i < size; i++) {
+        char c = content[i];
+
+        // Word tokens over the raw HTML.
+        if (isWordChar(c)) {
+            if (!inTerm) {
+                termStart = i;
+                inTerm = true;
+            }
+        } else if (inTerm) {
+            TermSpan span;
+            span.offset = static_cast<uint32_t>(termStart);
+            span.length = static_cast<uint32_t>(i - termStart);
+            page.terms.push_back(span);
+            inTerm = false;
+        }
+
+        if (c == '<') {
+            if (titleStart == npos && startsWithAt(content, i, "<title>")) titleStart = i;
+            if (titleEnd == npos && startsWithAt(content, i, "</title>")) titleEnd = i;
+            if (bodyEnd == npos && startsWithAt(content, i, "</body>")) {
+                bodyEnd = i;
+                collecting = false;
+            }
+            if (!foundDescription && startsWithAt(content, i, "<meta")) {
+                foundDescription = matchDescription(content, i, page.description);
+            }
+            if (i >= linkResume && startsWithAt(content, i, "<a") && i + 2 < size && isSpace(content[i + 2])) {
+                std::string link;
+                size_t end;
+                if (matchLink(content, i, link, end)) {
+                    page.links.push_back(link);
+                    linkResume = end;
+                }
+            }
+        }
+
+        if (collecting) {
+            if (c == '<') {
+                inTag = true;
+            } else if (c == '>') {
+                inTag = false;
+            } else if (!inTag) {
+                appendBodyChar(page, c, i, inBodyWord);
+            }
+        }
+
+        if (c == '<' && bodyTag == npos && startsWithAt(content, i, "<body")) {
+            bodyTag = i;
+        } else if (c == '>' && bodyTag != npos && bodyStart == npos) {
+            bodyStart = i + 1;
+            collecting = true;
+        }
+    }
+    if (inTerm) {
+        TermSpan span;
+        span.offset = static_cast<uint32_t>(termStart);
+        span.length = static_cast<uint32_t>(size - termStart);
+        page.terms.push_back(span);
+    }
+
+    if (titleStart != npos && titleEnd != npos) {
+        page.title.assign(content.substr(titleStart + 7, titleEnd - (titleStart + 7)));
+    } else {
+        page.title = "No Title";
+    }
+    if (!foundDescription) {
+        page.description = "No Description";
+    }
+
+    // Without both body markers the whole file is used instead.
+    if (bodyStart == npos || bodyEnd == npos) {
+        page.body.clear();
+        page.bodyRanges.clear();
+        page.bodyTerms.clear();
+        stripTags(content, 0, size, page);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef HTML_TOKENIZER_H
+#define HTML_TOKENIZER_H
+
+#include <string>
+#include <string_view>
+#include <list>
+#include <vector>
+#include "inverted_index.h"
+
+// A byte range [offset, offset + length) of a document's raw HTML.
+struct TextRange
+{
+    uint32_t offset;
+    uint32_t length;
+};
+
+// Everything the crawler needs from one HTML file, produced in a single pass.
+struct ParsedPage
+{
+    std::string title;              // <title> text, or "No Title"
+    std::string description;        // meta description, or "No Description"
+    std::string body;               // <body> contents with tags stripped
+    std::vector<TextRange> bodyRanges; // where each piece of 'body' sits in the raw HTML
+    std::list<std::string> links;   // href values of anchor tags, in document order
+    std::vector<TermSpan> terms;    // letter/digit runs of the raw HTML
+    std::vector<TermSpan> bodyTerms; // letter/digit runs of 'body'
+};
+
+// Streaming replacement for the old regex-based extractors. A single forward
+// scan over the file recognises <title>, <meta name="description">, <body>,
+// and <a href> tags as it reaches each '<', strips tags out of the body as it
+// goes, and records word tokens. The results are byte-for-byte what the
+// previous extractTitle/extractDescription/extractBodyContent/
+// extractLinksFromHTML functions returned.
+class HtmlTokenizer
+{
+public:
+    // Parse 'content' into 'page', reusing page's buffers.
+    void parse(std::string_view content, ParsedPage& page);
+
+private:
+    bool matchDescription(std::string_view content, size_t pos, std::string& description);
+    bool matchLink(std::string_view content, size_t pos, std::string& link, size_t& end);
+    void stripTags(std::string_view content, size_t begin, size_t end, ParsedPage& page);
+};
+
+#endif // HTML_TOKENIZER_H
@@ -0,0 +1,260 @@
+// Regression check for HtmlTokenizer: parses generated documents, stitched
+// together from the tags and near-misses the crawler has to tell apart, and
+// compares title, description, links and body with the regex-based
+// extractors it replaced (kept below as they were), and the word tokens and
+// body ranges with what they must describe. Exits with status 1 on any
+// difference.
+//
+//   ./html_tokenizer_check.exe [--documents N] [--seed X]
+
+#include "html_tokenizer.h"
+#include <cctype>
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <regex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// splitmix64, so the same seed checks the same documents everywhere.
+static uint64_t nextRandom(uint64_t& state)
+{
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// ===================================================
+// REFERENCE EXTRACTORS
+// ===================================================
+
+static std::list<std::string> referenceLinks(const std::string& fileContent)
+{
+    std::list<std::string> links;
+    std::regex linkRegex("<a\\s+[^>]*href\\s*=\\s*['\"]([^'\"]+)['\"][^>]*>");
+    std::smatch match;
+    std::string::const_iterator start = fileContent.cbegin();
+    while (std::regex_search(start, fileContent.cend(), match, linkRegex)) {
+        if (match.size() > 1) {
+            links.push_back(match[1].str());
+        }
+        start = match.suffix().first;
+    }
+    return links;
+}
+
+static std::string referenceTitle(const std::string& fileContent)
+{
+    size_t start = fileContent.find("<title>");
+    size_t end = fileContent.find("</title>");
+    if (start != std::string::npos && end != std::string::npos) {
+        return fileContent.substr(start + 7, end - (start + 7));
+    }
+    return "No Title";
+}
+
+static std::string referenceDescription(const std::string& fileContent)
+{
+    std::regex metaRegex("<meta\\s+name=\"description\"\\s+content=\"([^\"]+)\"");
+    std::smatch match;
+    if (std::regex_search(fileContent, match, metaRegex)) {
+        return match[1];
+    }
+    return "No Description";
+}
+
+static std::string referenceBody(const std::string& fileContent)
+{
+    size_t bodyStart = fileContent.find("<body");
+    if (bodyStart != std::string::npos) {
+        bodyStart = fileContent.find(">", bodyStart);
+        if (bodyStart != std::string::npos) {
+            bodyStart++;
+        }
+    }
+    size_t bodyEnd = fileContent.find("</body>");
+    std::string bodyContent;
+    if (bodyStart != std::string::npos && bodyEnd != std::string::npos) {
+        bodyContent = fileContent.substr(bodyStart, bodyEnd - bodyStart);
+    } else {
+        bodyContent = fileContent;
+    }
+
+    std::string result;
+    bool inTag = false;
+    for (char c : bodyContent) {
+        if (c == '<') {
+            inTag = true;
+            continue;
+        } else if (c == '>') {
+            inTag = false;
+            continue;
+        }
+        if (!inTag) {
+            result.push_back(c);
+        }
+    }
+    return result;
+}
+
+// Letter/digit runs of 'text', as TermSpans.
+static std::vector<TermSpan> referenceTerms(const std::string& text)
+{
+    std::vector<TermSpan> terms;
+    for (size_t i = 0; i < text.size(); ) {
+        if (!std::isalnum(static_cast<unsigned char>(text[i]))) {
+            i++;
+            continue;
+        }
+        TermSpan span;
+        span.offset = static_cast<uint32_t>(i);
+        while (i < text.size() && std::isalnum(static_cast<unsigned char>(text[i]))) {
+            i++;
+        }
+        span.length = static_cast<uint32_t>(i - span.offset);
+        terms.push_back(span);
+    }
+    return terms;
+}
+
+static bool sameTerms(const std::vector<TermSpan>& a, const std::vector<TermSpan>& b)
+{
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].offset != b[i].offset || a[i].length != b[i].length) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// ===================================================
+// DOCUMENTS
+// ===================================================
+
+// Pieces of HTML, well-formed and not: duplicated and misordered markers,
+// anchors with several hrefs or unterminated values, descriptions that
+// almost match.
+static const char* const fragments[] = {
+    "<html>", "<head>", "</head>", "<title>", "</title>", "<title>Page title</title>", "<body>",
+    "<body class=\"main\">", "</body>", "<body", "<p>", "</p>", "<br/>", "<b>bold</b>", "<!-- c -->", "<", ">",
+    " ", "\n", "\t", "  ", "\"", "'", "=", "&amp;", "a", "href",
+    "<meta name=\"description\" content=\"A description\">",
+    "<meta  name=\"description\"\n content=\"Spaced\">",
+    "<meta name=\"description\" content=\"\">",
+    "<meta name=\"description\"content=\"Glued\">",
+    "<meta name='description' content='Single'>",
+    "<meta name=\"keywords\" content=\"k\">",
+    "<meta name=\"description\" content=\"Unterminated",
+    "<a href=\"file1.html\">one</a>",
+    "<a href='sub/file2.html'>two</a>",
+    "<a  class=\"x\" href = \"../up.html\" >up</a>",
+    "<a href=\"first.html\" href=\"second.html\">both</a>",
+    "<a href=\"mixed.html'>mixed</a>",
+    "<a href=\"\">empty</a>",
+    "<a href=\"no-close.html\"",
+    "<a\thref=\"tab.html\">tab</a>",
+    "<a\nhref=\"newline.html\"\n>nl</a>",
+    "<ahref=\"glued.html\">glued</a>",
+    "<a title=\"href\" href=\"titled.html\">t</a>",
+    "<a href=\"a.html\" title=\"x>y\">gt</a>",
+    "<a href =\"b.html\"><a href= 'c.html'>nested</a>",
+    "<abbr href=\"abbr.html\">abbr</abbr>",
+    "<a>bare</a>",
+    "<A HREF=\"upper.html\">upper</A>",
+};
+
+static const size_t FRAGMENT_COUNT = sizeof(fragments) / sizeof(fragments[0]);
+
+static std::string makeDocument(uint64_t& random)
+{
+    static const char* const words[] = { "alpha", "Beta", "gamma42", "x", "7", "delta-epsilon", "zeta's", "ETA" };
+    std::string document;
+    size_t pieces = nextRandom(random) % 40;
+    for (size_t p = 0; p < pieces; p++) {
+        uint64_t r = nextRandom(random);
+        if (r % 3 == 0) {
+            document += words[(r >> 8) % 8];
+        } else {
+            document += fragments[(r >> 8) % FRAGMENT_COUNT];
+        }
+    }
+    return document;
+}
+
+int main(int argc, char** argv)
+{
+    size_t documents = 3000;
+    uint64_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (arg == "--documents") {
+            documents = std::strtoul(value.c_str(), nullptr, 10);
+        } else if (arg == "--seed") {
+            seed = std::strtoull(value.c_str(), nullptr, 10);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--documents N] [--seed X]" << std::endl;
+            return 1;
+        }
+    }
+
+    size_t failures = 0;
+    try {
+        uint64_t random = seed;
+        HtmlTokenizer tokenizer;
+        ParsedPage page;
+        size_t links = 0;
+        for (size_t d = 0; d < documents; d++) {
+            std::string document = makeDocument(random);
+            tokenizer.parse(document, page);
+
+            std::vector<std::string> differing;
+            if (page.title != referenceTitle(document)) differing.push_back("title");
+            if (page.description != referenceDescription(document)) differing.push_back("description");
+            if (page.links != referenceLinks(document)) differing.push_back("links");
+            if (page.body != referenceBody(document)) differing.push_back("body");
+            if (!sameTerms(page.terms, referenceTerms(document))) differing.push_back("terms");
+            if (!sameTerms(page.bodyTerms, referenceTerms(page.body))) differing.push_back("body terms");
+
+            // The ranges, in order and each as long as it can be, spell the body.
+            std::string spelled;
+            bool ordered = true;
+            for (size_t r = 0; r < page.bodyRanges.size(); r++) {
+                const TextRange& range = page.bodyRanges[r];
+                ordered = ordered && range.length > 0 && range.offset + range.length <= document.size() &&
+                          (r == 0 || page.bodyRanges[r - 1].offset + page.bodyRanges[r - 1].length < range.offset);
+                if (range.offset + range.length <= document.size()) {
+                    spelled.append(document, range.offset, range.length);
+                }
+            }
+            if (!ordered || spelled != page.body) differing.push_back("body ranges");
+
+            links += page.links.size();
+            if (!differing.empty() && failures++ < 10) {
+                std::cout << "DIFFERS in document " << d << ":";
+                for (const std::string& name : differing) {
+                    std::cout << " " << name;
+                }
+                std::cout << "\n" << document << std::endl;
+            }
+        }
+        std::cout << "Tokenizer: " << documents << " documents, " << links << " links checked" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return 1;
+    }
+    if (failures > 0) {
+        std::cout << failures << " documents differ" << std::endl;
+        return 1;
+    }
+    return 0;
+}
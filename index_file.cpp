@@ -0,0 +1,279 @@
+#include "index_file.h"
+#include <cstdio>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+static const char INDEX_MAGIC[8] = { 'N', 'Y', 'S', 'X', 'I', 'D', 'X', '\0' };
+
+struct IndexFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t section;
+    uint64_t payloadLength;
+    uint64_t checksum;
+    uint64_t build;
+};
+
+static size_t paddingFor(uint64_t length)
+{
+    return static_cast<size_t>((8 - length % 8) % 8);
+}
+
+std::string indexFilePath(const std::string& directory, IndexSection section)
+{
+    static const char* const names[] = {
+        "", "terms.nyx", "postings.nyx", "documents.nyx", "links.nyx", "stats.nyx", "content.nyx", "crawl.nyx"
+    };
+    return directory + "/" + names[section];
+}
+
+// ===================================================
+// CHECKSUM
+// ===================================================
+
+static const uint64_t CHECKSUM_PRIME = 0x9E3779B97F4A7C15ULL;
+
+static uint64_t mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+Checksum::Checksum() : tailLength(0), totalLength(0)
+{
+    for (int lane = 0; lane < 4; lane++) {
+        lanes[lane] = 0xCBF29CE484222325ULL + static_cast<uint64_t>(lane) * CHECKSUM_PRIME;
+    }
+}
+
+void Checksum::block(const unsigned char* bytes)
+{
+    for (int lane = 0; lane < 4; lane++) {
+        uint64_t word;
+        std::memcpy(&word, bytes + lane * 8, 8);
+        lanes[lane] = (lanes[lane] ^ word) * CHECKSUM_PRIME;
+        lanes[lane] ^= lanes[lane] >> 29;
+    }
+}
+
+void Checksum::update(const void* data, size_t length)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    totalLength += length;
+
+    // Top up a partial block left over from the previous call.
+    if (tailLength > 0) {
+        size_t take = std::min(length, sizeof(tail) - tailLength);
+        std::memcpy(tail + tailLength, bytes, take);
+        tailLength += take;
+        bytes += take;
+        length -= take;
+        if (tailLength < sizeof(tail)) {
+            return;
+        }
+        block(tail);
+        tailLength = 0;
+    }
+
+    while (length >= sizeof(tail)) {
+        block(bytes);
+        bytes += sizeof(tail);
+        length -= sizeof(tail);
+    }
+    std::memcpy(tail, bytes, length);
+    tailLength = length;
+}
+
+uint64_t Checksum::value() const
+{
+    uint64_t h = totalLength;
+    for (int lane = 0; lane < 4; lane++) {
+        h = (h ^ mix(lanes[lane])) * CHECKSUM_PRIME;
+    }
+    for (size_t i = 0; i < tailLength; i++) {
+        h = (h ^ tail[i]) * 0x100000001B3ULL;
+    }
+    return mix(h);
+}
+
+// ===================================================
+// WRITER
+// ===================================================
+
+IndexFileWriter::IndexFileWriter(const std::string& path, IndexSection section, uint64_t build)
+    : path(path), tmpPath(path + ".tmp"), section(section), build(build), payloadLength(0)
+{
+    out.open(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        throw std::runtime_error("cannot create index file " + tmpPath);
+    }
+    // Placeholder header; the real one is written by finish().
+    IndexFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+void IndexFileWriter::writeBytes(const void* data, size_t length)
+{
+    out.write(static_cast<const char*>(data), static_cast<std::streamsize>(length));
+    checksum.update(data, length);
+    payloadLength += length;
+}
+
+void IndexFileWriter::beginArray(uint64_t count)
+{
+    writeBytes(&count, sizeof(count));
+}
+
+void IndexFileWriter::endArray()
+{
+    static const char zeros[8] = {};
+    writeBytes(zeros, paddingFor(payloadLength));
+}
+
+void IndexFileWriter::writeStrings(const std::vector<std::string>& values)
+{
+    std::vector<uint64_t> starts;
+    starts.reserve(values.size() + 1);
+    uint64_t offset = 0;
+    for (const std::string& value : values) {
+        starts.push_back(offset);
+        offset += value.size();
+    }
+    starts.push_back(offset);
+    writeArray(starts);
+
+    beginArray(offset);
+    for (const std::string& value : values) {
+        append(value.data(), value.size());
+    }
+    endArray();
+}
+
+void IndexFileWriter::finish()
+{
+    IndexFileHeader header;
+    std::memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+    header.version = INDEX_FORMAT_VERSION;
+    header.section = static_cast<uint32_t>(section);
+    header.payloadLength = payloadLength;
+    header.checksum = checksum.value();
+    header.build = build;
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.close();
+    if (out.fail()) {
+        throw std::runtime_error("error writing index file " + tmpPath);
+    }
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("cannot rename " + tmpPath + " to " + path);
+    }
+}
+
+// ===================================================
+// READER
+// ===================================================
+
+IndexFileReader::IndexFileReader(MappedFile& file, const std::string& path, IndexSection section)
+    : path(path), cursor(0), buildId(0)
+{
+    if (!file.open(path)) {
+        throw std::runtime_error("cannot open index file " + path);
+    }
+    std::string_view contents = file.view();
+
+    IndexFileHeader header;
+    if (contents.size() < sizeof(header)) {
+        fail("truncated header");
+    }
+    std::memcpy(&header, contents.data(), sizeof(header));
+    if (std::memcmp(header.magic, INDEX_MAGIC, sizeof(header.magic)) != 0) {
+        fail("not an index file");
+    }
+    if (header.version != INDEX_FORMAT_VERSION) {
+        fail("format version " + std::to_string(header.version) + ", expected " +
+             std::to_string(INDEX_FORMAT_VERSION));
+    }
+    if (header.section != static_cast<uint32_t>(section)) {
+        fail("wrong section");
+    }
+    if (header.payloadLength != contents.size() - sizeof(header)) {
+        fail("payload size mismatch");
+    }
+
+    payload = contents.substr(sizeof(header));
+    Checksum checksum;
+    checksum.update(payload.data(), payload.size());
+    if (checksum.value() != header.checksum) {
+        fail("checksum mismatch");
+    }
+    buildId = header.build;
+}
+
+void IndexFileReader::expectBuild(uint64_t expected) const
+{
+    if (buildId != expected) {
+        fail("written by a different build of the index");
+    }
+}
+
+void IndexFileReader::fail(const std::string& reason) const
+{
+    throw std::runtime_error("corrupt index file " + path + ": " + reason);
+}
+
+void IndexFileReader::skip(size_t length)
+{
+    if (length > payload.size() - cursor) {
+        fail("array runs past end of file");
+    }
+    cursor += length;
+}
+
+uint64_t IndexFileReader::readCount(size_t elementSize)
+{
+    // Arrays start on an 8-byte boundary, after the previous array's padding.
+    skip(paddingFor(cursor));
+    if (payload.size() - cursor < sizeof(uint64_t)) {
+        fail("array runs past end of file");
+    }
+    uint64_t count;
+    std::memcpy(&count, payload.data() + cursor, sizeof(count));
+    cursor += sizeof(count);
+    if (count > (payload.size() - cursor) / elementSize) {
+        fail("array runs past end of file");
+    }
+    return count;
+}
+
+void IndexFileReader::readStrings(std::vector<std::string>& values)
+{
+    size_t startCount, length;
+    const uint64_t* starts = readArray<uint64_t>(startCount);
+    const char* bytes = readArray<char>(length);
+    if (startCount == 0) {
+        fail("empty string table");
+    }
+    values.clear();
+    values.reserve(startCount - 1);
+    for (size_t i = 0; i + 1 < startCount; i++) {
+        if (starts[i] > starts[i + 1] || starts[i + 1] > length) {
+            fail("bad string offsets");
+        }
+        values.emplace_back(bytes + starts[i], starts[i + 1] - starts[i]);
+    }
+}
+
+void IndexFileReader::finish()
+{
+    skip(paddingFor(cursor));
+    if (cursor != payload.size()) {
+        fail("unexpected data after last array");
+    }
+}
@@ -0,0 +1,193 @@
+#ifndef INDEX_FILE_H
+#define INDEX_FILE_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "mapped_file.h"
+
+// On-disk index written by --build-index and mapped by --index. The index is
+// a directory holding one file per section; every file is a fixed header
+// followed by a payload made of arrays:
+//
+//   header: magic "NYSXIDX\0" | u32 version | u32 section | u64 payload size | u64 checksum | u64 build
+//   array:  u64 element count | elements | zero padding to a multiple of 8 bytes
+//
+// Arrays always start 8-byte aligned, so a loaded index can point straight
+// into the mapping instead of copying. Integers are in host byte order; a
+// file from a machine of the other endianness fails the version check.
+//
+// Each file is renamed into place on its own, so a save that stops halfway
+// leaves some sections from the new index and some from the old one. The
+// build id ties them together: every file of one save carries the same id
+// (a checksum of the crawled URLs and HTML, see DocumentTable::fingerprint),
+// and loading rejects a section whose id differs from documents.nyx's.
+
+const uint32_t INDEX_FORMAT_VERSION = 8;
+
+enum IndexSection
+{
+    SECTION_TERMS = 1,     // sorted term dictionary
+    SECTION_POSTINGS = 2,  // compressed postings blocks with positions and byte offsets
+    SECTION_DOCUMENTS = 3, // URL, title, description, body ranges and sentence ends per document
+    SECTION_LINKS = 4,     // CSR link graph, out-degrees, backlinks scores and PageRank
+    SECTION_STATS = 5,     // corpus-wide word counts and lengths
+    SECTION_CONTENT = 6,   // raw HTML of every document and its lowercase shadow
+    SECTION_CRAWL = 7      // seed, file states and local hrefs, for --update-index
+};
+
+// Path of one section's file inside an index directory.
+std::string indexFilePath(const std::string& directory, IndexSection section);
+
+// 64-bit checksum of a byte stream. Four independent multiply-xor lanes over
+// 32-byte blocks keep verification of large files close to memory speed.
+class Checksum
+{
+public:
+    Checksum();
+    void update(const void* data, size_t length);
+    uint64_t value() const;
+
+private:
+    void block(const unsigned char* bytes);
+
+    uint64_t lanes[4];
+    unsigned char tail[32];
+    size_t tailLength;
+    uint64_t totalLength;
+};
+
+// An array that either owns its elements or points into a mapped index file.
+template <typename T>
+class StoredArray
+{
+public:
+    StoredArray() : elements(nullptr), count(0) {}
+    StoredArray(StoredArray&&) = default;
+    StoredArray& operator=(StoredArray&&) = default;
+    StoredArray(const StoredArray&) = delete;
+    StoredArray& operator=(const StoredArray&) = delete;
+
+    void assign(std::vector<T>&& values)
+    {
+        owned.swap(values);
+        elements = owned.data();
+        count = owned.size();
+    }
+    void attach(const T* values, size_t size)
+    {
+        std::vector<T>().swap(owned);
+        elements = values;
+        count = size;
+    }
+    void clear() { attach(nullptr, 0); }
+
+    const T* data() const { return elements; }
+    size_t size() const { return count; }
+    const T& operator[](size_t i) const { return elements[i]; }
+
+private:
+    std::vector<T> owned;
+    const T* elements;
+    size_t count;
+};
+
+// Writes one section file. Data goes to "<path>.tmp", which finish() renames
+// into place once the header is complete, so an interrupted build never leaves
+// a file that looks valid. Throws std::runtime_error on I/O errors.
+class IndexFileWriter
+{
+public:
+    IndexFileWriter(const std::string& path, IndexSection section, uint64_t build);
+
+    template <typename T>
+    void writeArray(const T* values, size_t count)
+    {
+        beginArray(count);
+        append(values, count);
+        endArray();
+    }
+    template <typename T>
+    void writeArray(const std::vector<T>& values) { writeArray(values.data(), values.size()); }
+
+    // Strings are stored as a u64 array of count + 1 start offsets followed by
+    // a char array of their concatenated bytes.
+    void writeStrings(const std::vector<std::string>& values);
+
+    // An array written in pieces: declare its element count, append exactly
+    // that many elements, then end it.
+    void beginArray(uint64_t count);
+    template <typename T>
+    void append(const T* values, size_t count) { writeBytes(values, count * sizeof(T)); }
+    void endArray();
+
+    void finish();
+
+private:
+    void writeBytes(const void* data, size_t length);
+
+    std::string path;
+    std::string tmpPath;
+    IndexSection section;
+    uint64_t build;
+    std::ofstream out;
+    uint64_t payloadLength;
+    Checksum checksum;
+};
+
+// Reads the arrays of one section file in the order they were written. The
+// constructor maps the file into 'file' and verifies its header and checksum;
+// pointers returned by readArray() stay valid for as long as 'file' is open.
+// Every read is bounds-checked; any problem throws std::runtime_error.
+class IndexFileReader
+{
+public:
+    IndexFileReader(MappedFile& file, const std::string& path, IndexSection section);
+
+    template <typename T>
+    const T* readArray(size_t& count)
+    {
+        count = static_cast<size_t>(readCount(sizeof(T)));
+        const T* values = reinterpret_cast<const T*>(payload.data() + cursor);
+        skip(count * sizeof(T));
+        return values;
+    }
+    template <typename T>
+    void readArray(std::vector<T>& values)
+    {
+        size_t count;
+        const T* data = readArray<T>(count);
+        values.assign(data, data + count);
+    }
+    template <typename T>
+    void readArray(StoredArray<T>& values)
+    {
+        size_t count;
+        const T* data = readArray<T>(count);
+        values.attach(data, count);
+    }
+    void readStrings(std::vector<std::string>& values);
+
+    // Build id from the header, and a check that it is the expected one.
+    uint64_t build() const { return buildId; }
+    void expectBuild(uint64_t expected) const;
+
+    // Throws unless every array has been read.
+    void finish();
+
+    // Throws the "corrupt index" error for this file.
+    [[noreturn]] void fail(const std::string& reason) const;
+
+private:
+    uint64_t readCount(size_t elementSize);
+    void skip(size_t length);
+
+    std::string path;
+    std::string_view payload;
+    size_t cursor;
+    uint64_t buildId;
+};
+
+#endif // INDEX_FILE_H
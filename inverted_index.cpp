@@ -0,0 +1,804 @@
+#include "inverted_index.h"
+#include "stream_vbyte.h"
+#include <algorithm>
+#include <cctype>
+
+// ===================================================
+// TOKENIZATION
+// ===================================================
+
+std::vector<std::string> splitTerms(const std::string& text)
+{
+    std::vector<std::string> result;
+    std::string current;
+    for (char c : text) {
+        unsigned char uc = static_cast<unsigned char>(c);
+        if (std::isalnum(uc)) {
+            current.push_back(static_cast<char>(std::tolower(uc)));
+        } else if (!current.empty()) {
+            result.push_back(current);
+            current.clear();
+        }
+    }
+    if (!current.empty()) {
+        result.push_back(current);
+    }
+    return result;
+}
+
+bool isSingleTerm(const std::string& text)
+{
+    if (text.empty()) return false;
+    for (char c : text) {
+        if (!std::isalnum(static_cast<unsigned char>(c))) return false;
+    }
+    return true;
+}
+
+// ===================================================
+// INVERTED INDEX
+// ===================================================
+
+void InvertedIndex::clear()
+{
+    building.clear();
+    textLength.clear();
+    documentRemap.clear();
+    updating = false;
+    documentTotal = 0;
+    termText.clear();
+    termStart.clear();
+    postingStart.clear();
+    blockStart.clear();
+    maxDensity.clear();
+    blocks.clear();
+    postingData.clear();
+    termsFile.close();
+    postingsFile.close();
+}
+
+void InvertedIndex::addDocument(DocId doc, std::string_view text)
+{
+    std::vector<TermSpan> tokens;
+    size_t start = 0;
+    bool inTerm = false;
+    for (size_t i = 0; i <= text.size(); i++) {
+        if (i < text.size() && std::isalnum(static_cast<unsigned char>(text[i]))) {
+            if (!inTerm) {
+                start = i;
+                inTerm = true;
+            }
+        } else if (inTerm) {
+            TermSpan span;
+            span.offset = static_cast<uint32_t>(start);
+            span.length = static_cast<uint32_t>(i - start);
+            tokens.push_back(span);
+            inTerm = false;
+        }
+    }
+    addDocument(doc, text, tokens);
+}
+
+void InvertedIndex::addDocument(DocId doc, std::string_view text, const std::vector<TermSpan>& tokens)
+{
+    // Collect this document's postings first so each term gets exactly one
+    // posting appended to its list.
+    std::unordered_map<std::string, Posting> documentPostings;
+    std::string term;
+    for (uint32_t position = 0; position < tokens.size(); position++) {
+        const TermSpan& span = tokens[position];
+        term.assign(text.substr(span.offset, span.length));
+        for (char& c : term) {
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+        Posting& posting = documentPostings[term];
+        posting.doc = doc;
+        posting.tf++;
+        posting.positions.push_back(position);
+        posting.offsets.push_back(span.offset);
+    }
+
+    if (textLength.size() <= doc) {
+        textLength.resize(doc + 1, 0);
+    }
+    textLength[doc] = static_cast<uint32_t>(text.size());
+    for (auto& entry : documentPostings) {
+        building[entry.first].push_back(std::move(entry.second));
+    }
+}
+
+void InvertedIndex::beginUpdate(std::vector<DocId> remap, std::vector<uint32_t> lengths)
+{
+    building.clear();
+    documentRemap.swap(remap);
+    textLength.swap(lengths);
+    updating = true;
+}
+
+namespace
+{
+
+const DocId DROPPED_DOC = static_cast<DocId>(-1);
+
+// Appends one term's postings list to the compressed layout, a block at a
+// time. Postings come in DocId order, either from addDocument() or as the
+// occurrence deltas a block already stores.
+class ListWriter
+{
+public:
+    ListWriter(std::vector<PostingBlock>& blocks, std::vector<uint8_t>& data)
+        : blocks(blocks), data(data), previous(0), count(0) {}
+
+    void add(DocId doc, uint32_t tf, const uint32_t* positionDeltas, const uint32_t* offsetDeltas)
+    {
+        deltas.push_back(doc - previous);
+        previous = doc;
+        frequencies.push_back(tf);
+        positions.insert(positions.end(), positionDeltas, positionDeltas + tf);
+        offsets.insert(offsets.end(), offsetDeltas, offsetDeltas + tf);
+        count++;
+        if (deltas.size() == POSTING_BLOCK_SIZE) {
+            flush();
+        }
+    }
+
+    void add(const Posting& posting)
+    {
+        deltas.push_back(posting.doc - previous);
+        previous = posting.doc;
+        frequencies.push_back(posting.tf);
+        for (size_t j = 0; j < posting.positions.size(); j++) {
+            positions.push_back(posting.positions[j] - (j == 0 ? 0 : posting.positions[j - 1]));
+            offsets.push_back(posting.offsets[j] - (j == 0 ? 0 : posting.offsets[j - 1]));
+        }
+        count++;
+        if (deltas.size() == POSTING_BLOCK_SIZE) {
+            flush();
+        }
+    }
+
+    // True when the next posting starts a new block.
+    bool atBlockStart() const { return deltas.empty(); }
+
+    // Append a whole block of a frozen list whose documents are now 'docs'.
+    // Only the document stream changes; the other streams are copied as they
+    // are, which gives the same bytes as encoding the postings again.
+    void copyBlock(const DocId* docs, size_t entries, const PostingBlock& block, const uint8_t* streams)
+    {
+        for (size_t i = 0; i < entries; i++) {
+            deltas.push_back(docs[i] - previous);
+            previous = docs[i];
+        }
+        PostingBlock copy = block;
+        copy.data = data.size();
+        copy.lastDoc = previous;
+        copy.docBytes = static_cast<uint32_t>(streamVByteEncode(deltas.data(), deltas.size(), data));
+        data.insert(data.end(), streams + block.docBytes,
+                    streams + block.docBytes + block.tfBytes + block.positionBytes + block.offsetBytes);
+        blocks.push_back(copy);
+        deltas.clear();
+        count += entries;
+    }
+
+    // Write out the last, partial block.
+    void finish()
+    {
+        if (!deltas.empty()) {
+            flush();
+        }
+    }
+
+    size_t size() const { return count; }
+
+private:
+    void flush()
+    {
+        PostingBlock block;
+        block.data = data.size();
+        block.lastDoc = previous;
+        block.occurrences = static_cast<uint32_t>(positions.size());
+        block.docBytes = static_cast<uint32_t>(streamVByteEncode(deltas.data(), deltas.size(), data));
+        block.tfBytes = static_cast<uint32_t>(streamVByteEncode(frequencies.data(), frequencies.size(), data));
+        block.positionBytes = static_cast<uint32_t>(streamVByteEncode(positions.data(), positions.size(), data));
+        block.offsetBytes = static_cast<uint32_t>(streamVByteEncode(offsets.data(), offsets.size(), data));
+        blocks.push_back(block);
+        deltas.clear();
+        frequencies.clear();
+        positions.clear();
+        offsets.clear();
+    }
+
+    std::vector<PostingBlock>& blocks;
+    std::vector<uint8_t>& data;
+    DocId previous;
+    size_t count;
+    std::vector<uint32_t> deltas;
+    std::vector<uint32_t> frequencies;
+    std::vector<uint32_t> positions;
+    std::vector<uint32_t> offsets;
+};
+
+// Write a frozen list of 'count' postings (skip entries 'blocks', streams in
+// 'data') with its documents renumbered by 'remap', leaving out those mapped
+// to DROPPED_DOC, merged with the new postings 'added'. Whole blocks that
+// keep all their documents and line up with the new block boundaries are
+// copied rather than decoded, so a list keeps most of its blocks when a few
+// documents change. Returns the largest density of the written list.
+double mergeList(const PostingBlock* blocks, const uint8_t* data, size_t count, double density,
+                 const std::vector<DocId>& remap, const std::vector<Posting>& added,
+                 const std::vector<uint32_t>& textLength, ListWriter& writer)
+{
+    // Renumber first: a list that loses a document needs its density again.
+    std::vector<DocId> docs(count);
+    bool dropped = false;
+    size_t blockCount = (count + POSTING_BLOCK_SIZE - 1) / POSTING_BLOCK_SIZE;
+    for (size_t b = 0; b < blockCount; b++) {
+        size_t first = b * POSTING_BLOCK_SIZE;
+        size_t entries = std::min(POSTING_BLOCK_SIZE, count - first);
+        streamVByteDecode(data + blocks[b].data, blocks[b].docBytes, entries, &docs[first]);
+        prefixSum(&docs[first], entries, b == 0 ? 0 : blocks[b - 1].lastDoc);
+        for (size_t i = first; i < first + entries; i++) {
+            docs[i] = remap[docs[i]];
+            dropped = dropped || docs[i] == DROPPED_DOC;
+        }
+    }
+    if (dropped) {
+        density = 0.0;
+    }
+
+    uint32_t frequencies[POSTING_BLOCK_SIZE];
+    std::vector<uint32_t> positions;
+    std::vector<uint32_t> offsets;
+    size_t next = 0; // first posting of 'added' not yet written
+    for (size_t b = 0; b < blockCount; b++) {
+        const PostingBlock& block = blocks[b];
+        const uint8_t* streams = data + block.data;
+        const DocId* blockDocs = &docs[b * POSTING_BLOCK_SIZE];
+        size_t entries = std::min(POSTING_BLOCK_SIZE, count - b * POSTING_BLOCK_SIZE);
+        bool intact = std::find(blockDocs, blockDocs + entries, DROPPED_DOC) == blockDocs + entries;
+        if (intact) {
+            while (next < added.size() && added[next].doc < blockDocs[0]) {
+                writer.add(added[next++]);
+            }
+            bool lastOfList = next == added.size() && b + 1 == blockCount;
+            if (writer.atBlockStart() && (entries == POSTING_BLOCK_SIZE || lastOfList) &&
+                (next == added.size() || added[next].doc > blockDocs[entries - 1])) {
+                if (dropped) {
+                    streamVByteDecode(streams + block.docBytes, block.tfBytes, entries, frequencies);
+                    for (size_t i = 0; i < entries; i++) {
+                        density = std::max(density, static_cast<double>(frequencies[i]) / textLength[blockDocs[i]]);
+                    }
+                }
+                writer.copyBlock(blockDocs, entries, block, streams);
+                continue;
+            }
+        }
+
+        streamVByteDecode(streams + block.docBytes, block.tfBytes, entries, frequencies);
+        positions.resize(block.occurrences);
+        offsets.resize(block.occurrences);
+        streams += block.docBytes + block.tfBytes;
+        streamVByteDecode(streams, block.positionBytes, block.occurrences, positions.data());
+        streamVByteDecode(streams + block.positionBytes, block.offsetBytes, block.occurrences, offsets.data());
+        size_t occurrence = 0;
+        for (size_t i = 0; i < entries; i++) {
+            if (blockDocs[i] != DROPPED_DOC) {
+                while (next < added.size() && added[next].doc < blockDocs[i]) {
+                    writer.add(added[next++]);
+                }
+                writer.add(blockDocs[i], frequencies[i], &positions[occurrence], &offsets[occurrence]);
+                if (dropped) {
+                    density = std::max(density, static_cast<double>(frequencies[i]) / textLength[blockDocs[i]]);
+                }
+            }
+            occurrence += frequencies[i];
+        }
+    }
+    while (next < added.size()) {
+        writer.add(added[next++]);
+    }
+    for (const Posting& posting : added) {
+        density = std::max(density, static_cast<double>(posting.tf) / textLength[posting.doc]);
+    }
+    return density;
+}
+
+} // namespace
+
+void InvertedIndex::freeze()
+{
+    std::vector<std::string> sortedTerms;
+    sortedTerms.reserve(building.size());
+    for (const auto& entry : building) {
+        sortedTerms.push_back(entry.first);
+    }
+    std::sort(sortedTerms.begin(), sortedTerms.end());
+
+    // An update merges the frozen dictionary with the new terms.
+    size_t frozenTerms = updating && termStart.size() > 0 ? termStart.size() - 1 : 0;
+    const std::vector<Posting> none;
+
+    std::vector<char> text;
+    std::vector<uint64_t> textStart(1, 0);
+    std::vector<uint64_t> listStart(1, 0);
+    std::vector<uint64_t> listBlocks(1, 0);
+    std::vector<double> densities;
+    std::vector<PostingBlock> blockTable;
+    std::vector<uint8_t> data;
+    size_t t = 0;
+    size_t n = 0;
+    while (t < frozenTerms || n < sortedTerms.size()) {
+        int order = t == frozenTerms ? 1 : n == sortedTerms.size() ? -1 : term(t).compare(sortedTerms[n]);
+        std::string_view name = order <= 0 ? term(t) : std::string_view(sortedTerms[n]);
+        std::vector<Posting>* list = nullptr;
+        if (order >= 0) {
+            list = &building[sortedTerms[n]];
+        }
+        const std::vector<Posting>& added = list != nullptr ? *list : none;
+
+        size_t blocksBefore = blockTable.size();
+        size_t dataBefore = data.size();
+        ListWriter writer(blockTable, data);
+        double density = 0.0;
+        if (order <= 0) {
+            density = mergeList(blocks.data() + blockStart[t], postingData.data(),
+                                static_cast<size_t>(postingStart[t + 1] - postingStart[t]), maxDensity[t],
+                                documentRemap, added, textLength, writer);
+        } else {
+            for (const Posting& posting : added) {
+                writer.add(posting);
+                density = std::max(density, static_cast<double>(posting.tf) / textLength[posting.doc]);
+            }
+        }
+        writer.finish();
+        if (order <= 0) t++;
+        if (order >= 0) n++;
+        if (list != nullptr) {
+            std::vector<Posting>().swap(*list);
+        }
+        if (writer.size() == 0) {
+            // Every document with the term was dropped.
+            blockTable.resize(blocksBefore);
+            data.resize(dataBefore);
+            continue;
+        }
+
+        text.insert(text.end(), name.begin(), name.end());
+        textStart.push_back(text.size());
+        listStart.push_back(listStart.back() + writer.size());
+        listBlocks.push_back(blockTable.size());
+        densities.push_back(density);
+    }
+    building.clear();
+    documentTotal = textLength.size();
+    std::vector<uint32_t>().swap(textLength);
+    std::vector<DocId>().swap(documentRemap);
+    updating = false;
+
+    termText.assign(std::move(text));
+    termStart.assign(std::move(textStart));
+    postingStart.assign(std::move(listStart));
+    blockStart.assign(std::move(listBlocks));
+    maxDensity.assign(std::move(densities));
+    blocks.assign(std::move(blockTable));
+    postingData.assign(std::move(data));
+    // A loaded index's lists have been copied out of the mapping.
+    termsFile.close();
+    postingsFile.close();
+}
+
+void InvertedIndex::save(const std::string& directory, uint64_t build) const
+{
+    IndexFileWriter termsOut(indexFilePath(directory, SECTION_TERMS), SECTION_TERMS, build);
+    termsOut.writeArray(termStart.data(), termStart.size());
+    termsOut.writeArray(termText.data(), termText.size());
+    termsOut.writeArray(postingStart.data(), postingStart.size());
+    termsOut.writeArray(blockStart.data(), blockStart.size());
+    termsOut.writeArray(maxDensity.data(), maxDensity.size());
+    termsOut.finish();
+
+    IndexFileWriter postingsOut(indexFilePath(directory, SECTION_POSTINGS), SECTION_POSTINGS, build);
+    postingsOut.writeArray(blocks.data(), blocks.size());
+    postingsOut.writeArray(postingData.data(), postingData.size());
+    postingsOut.finish();
+}
+
+void InvertedIndex::load(const std::string& directory, size_t documentCount, uint64_t build)
+{
+    clear();
+
+    IndexFileReader termsIn(termsFile, indexFilePath(directory, SECTION_TERMS), SECTION_TERMS);
+    termsIn.expectBuild(build);
+    termsIn.readArray(termStart);
+    termsIn.readArray(termText);
+    termsIn.readArray(postingStart);
+    termsIn.readArray(blockStart);
+    termsIn.readArray(maxDensity);
+    termsIn.finish();
+
+    IndexFileReader postingsIn(postingsFile, indexFilePath(directory, SECTION_POSTINGS), SECTION_POSTINGS);
+    postingsIn.expectBuild(build);
+    postingsIn.readArray(blocks);
+    postingsIn.readArray(postingData);
+    postingsIn.finish();
+    documentTotal = documentCount;
+
+    // The arrays are used in place, so check that every range they describe
+    // stays inside them before any query follows one.
+    size_t termTotal = termStart.size() == 0 ? 0 : termStart.size() - 1;
+    if (termStart.size() == 0 || postingStart.size() != termStart.size() || blockStart.size() != termStart.size() ||
+        maxDensity.size() != termTotal || termStart[termTotal] != termText.size() ||
+        blockStart[termTotal] != blocks.size()) {
+        termsIn.fail("postings do not match the term dictionary");
+    }
+    for (size_t t = 0; t < termTotal; t++) {
+        if (termStart[t] > termStart[t + 1] || postingStart[t] > postingStart[t + 1] ||
+            blockStart[t + 1] - blockStart[t] !=
+                (postingStart[t + 1] - postingStart[t] + POSTING_BLOCK_SIZE - 1) / POSTING_BLOCK_SIZE) {
+            termsIn.fail("term ranges out of order");
+        }
+    }
+
+    // Decoding trusts the stream sizes, so check those against the control
+    // bytes, then decode every block once to check its contents.
+    std::vector<uint32_t> values;
+    for (size_t t = 0; t < termTotal; t++) {
+        size_t remaining = static_cast<size_t>(postingStart[t + 1] - postingStart[t]);
+        DocId previous = 0;
+        for (uint64_t b = blockStart[t]; b < blockStart[t + 1]; b++) {
+            const PostingBlock& block = blocks[b];
+            size_t count = std::min(POSTING_BLOCK_SIZE, remaining);
+            remaining -= count;
+            uint64_t end = block.data + block.docBytes + block.tfBytes + block.positionBytes + block.offsetBytes;
+            if (block.data > postingData.size() || end > postingData.size()) {
+                postingsIn.fail("block out of range");
+            }
+            const uint8_t* data = postingData.data() + block.data;
+            if (streamVByteSize(data, count, block.docBytes) != block.docBytes ||
+                streamVByteSize(data + block.docBytes, count, block.tfBytes) != block.tfBytes ||
+                streamVByteSize(data + block.docBytes + block.tfBytes, block.occurrences, block.positionBytes) != block.positionBytes ||
+                streamVByteSize(data + block.docBytes + block.tfBytes + block.positionBytes, block.occurrences,
+                                block.offsetBytes) != block.offsetBytes) {
+                postingsIn.fail("bad block");
+            }
+
+            values.resize(count);
+            streamVByteDecode(data, block.docBytes, count, values.data());
+            for (size_t i = 0; i < count; i++) {
+                uint64_t doc = static_cast<uint64_t>(previous) + values[i];
+                if ((values[i] == 0 && (b != blockStart[t] || i != 0)) || doc >= documentCount) {
+                    postingsIn.fail("bad posting");
+                }
+                previous = static_cast<DocId>(doc);
+            }
+            if (previous != block.lastDoc) {
+                postingsIn.fail("bad posting");
+            }
+            streamVByteDecode(data + block.docBytes, block.tfBytes, count, values.data());
+            uint64_t occurrences = 0;
+            for (size_t i = 0; i < count; i++) {
+                if (values[i] == 0) {
+                    postingsIn.fail("bad posting");
+                }
+                occurrences += values[i];
+            }
+            if (occurrences != block.occurrences) {
+                postingsIn.fail("bad posting");
+            }
+        }
+    }
+}
+
+size_t InvertedIndex::occurrenceCount() const
+{
+    size_t total = 0;
+    for (size_t b = 0; b < blocks.size(); b++) {
+        total += blocks[b].occurrences;
+    }
+    return total;
+}
+
+PostingList InvertedIndex::postings(const std::string& term) const
+{
+    // Binary search the sorted term dictionary.
+    size_t low = 0;
+    size_t high = termStart.size() == 0 ? 0 : termStart.size() - 1;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        std::string_view candidate(termText.data() + termStart[mid], termStart[mid + 1] - termStart[mid]);
+        int order = candidate.compare(term);
+        if (order == 0) {
+            return PostingList(blocks.data() + blockStart[mid], postingData.data(),
+                               static_cast<size_t>(postingStart[mid + 1] - postingStart[mid]), maxDensity[mid]);
+        }
+        if (order < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return PostingList();
+}
+
+// ===================================================
+// POSTINGS ITERATION
+// ===================================================
+
+PostingIterator::PostingIterator(const PostingList& list)
+    : list(list), block(0), entry(0), entries(0), frequenciesDecoded(false), occurrencesDecoded(false)
+{
+    decodeBlock(0);
+}
+
+void PostingIterator::decodeBlock(size_t b)
+{
+    block = b;
+    entry = 0;
+    frequenciesDecoded = false;
+    occurrencesDecoded = false;
+    if (b >= list.blockCount()) {
+        entries = 0;
+        return;
+    }
+    const PostingBlock& skip = list.blocks[b];
+    entries = std::min(POSTING_BLOCK_SIZE, list.count - b * POSTING_BLOCK_SIZE);
+    streamVByteDecode(list.data + skip.data, skip.docBytes, entries, docs);
+    prefixSum(docs, entries, b == 0 ? 0 : list.blocks[b - 1].lastDoc);
+}
+
+void PostingIterator::decodeFrequencies()
+{
+    const PostingBlock& skip = list.blocks[block];
+    streamVByteDecode(list.data + skip.data + skip.docBytes, skip.tfBytes, entries, frequencies);
+    frequenciesDecoded = true;
+}
+
+void PostingIterator::decodeOccurrences()
+{
+    if (!frequenciesDecoded) {
+        decodeFrequencies();
+    }
+    occurrenceStart[0] = 0;
+    for (size_t i = 0; i < entries; i++) {
+        occurrenceStart[i + 1] = occurrenceStart[i] + frequencies[i];
+    }
+    const PostingBlock& skip = list.blocks[block];
+    const uint8_t* streams = list.data + skip.data + skip.docBytes + skip.tfBytes;
+    positionData.resize(skip.occurrences);
+    offsetData.resize(skip.occurrences);
+    streamVByteDecode(streams, skip.positionBytes, skip.occurrences, positionData.data());
+    streamVByteDecode(streams + skip.positionBytes, skip.offsetBytes, skip.occurrences, offsetData.data());
+    for (size_t i = 0; i < entries; i++) {
+        prefixSum(positionData.data() + occurrenceStart[i], frequencies[i], 0);
+        prefixSum(offsetData.data() + occurrenceStart[i], frequencies[i], 0);
+    }
+    occurrencesDecoded = true;
+}
+
+uint32_t PostingIterator::tf()
+{
+    if (!frequenciesDecoded) {
+        decodeFrequencies();
+    }
+    return frequencies[entry];
+}
+
+const uint32_t* PostingIterator::positions()
+{
+    if (!occurrencesDecoded) {
+        decodeOccurrences();
+    }
+    return positionData.data() + occurrenceStart[entry];
+}
+
+const uint32_t* PostingIterator::offsets()
+{
+    if (!occurrencesDecoded) {
+        decodeOccurrences();
+    }
+    return offsetData.data() + occurrenceStart[entry];
+}
+
+bool PostingIterator::advance(DocId target)
+{
+    if (atEnd()) {
+        return false;
+    }
+    if (list.blocks[block].lastDoc < target) {
+        // Binary search the skip entries of the blocks ahead.
+        const PostingBlock* first = list.blocks + block + 1;
+        const PostingBlock* last = list.blocks + list.blockCount();
+        const PostingBlock* found = std::lower_bound(first, last, target,
+            [](const PostingBlock& skip, DocId doc)
+            {
+                return skip.lastDoc < doc;
+            });
+        decodeBlock(static_cast<size_t>(found - list.blocks));
+        if (atEnd()) {
+            return false;
+        }
+    }
+    entry = static_cast<size_t>(std::lower_bound(docs + entry, docs + entries, target) - docs);
+    return true;
+}
+
+// ===================================================
+// QUERY PLANNING
+// ===================================================
+
+// A list this many times longer than the documents still in play is probed
+// per document through its skip entries instead of being decoded in full.
+static const size_t GALLOP_RATIO = 8;
+
+// Lists holding at least 1/BITMAP_DENSITY of all documents are cheaper to
+// AND as bitmaps than to merge.
+static const size_t BITMAP_DENSITY = 16;
+
+std::vector<DocId> InvertedIndex::intersect(const std::vector<std::string>& queryTerms) const
+{
+    return intersect(planIntersection(queryTerms));
+}
+
+IntersectPlan InvertedIndex::planIntersection(const std::vector<std::string>& queryTerms) const
+{
+    IntersectPlan plan;
+    plan.documentCount = documentTotal;
+    std::vector<std::string> distinct = queryTerms;
+    std::sort(distinct.begin(), distinct.end());
+    distinct.erase(std::unique(distinct.begin(), distinct.end()), distinct.end());
+    for (const std::string& term : distinct) {
+        IntersectStep step;
+        step.term = term;
+        step.list = postings(term);
+        step.method = INTERSECT_MERGE;
+        plan.steps.push_back(step);
+    }
+    if (plan.steps.empty()) {
+        return plan;
+    }
+
+    // Rarest first (ties in term order, so plans are stable).
+    std::stable_sort(plan.steps.begin(), plan.steps.end(),
+        [](const IntersectStep& a, const IntersectStep& b)
+        {
+            return a.list.size() < b.list.size();
+        });
+    plan.steps[0].method = INTERSECT_DRIVE;
+
+    bool dense = plan.steps.size() > 1 && plan.steps[0].list.size() * BITMAP_DENSITY >= documentTotal;
+    // The running result is at most as long as the rarest list.
+    size_t estimate = plan.steps[0].list.size();
+    for (size_t i = 1; i < plan.steps.size(); i++) {
+        size_t length = plan.steps[i].list.size();
+        if (dense) {
+            plan.steps[i].method = INTERSECT_BITMAP;
+        } else if (length >= estimate * GALLOP_RATIO) {
+            plan.steps[i].method = INTERSECT_GALLOP;
+        } else {
+            plan.steps[i].method = INTERSECT_MERGE;
+        }
+    }
+    return plan;
+}
+
+std::vector<DocId> InvertedIndex::intersect(const IntersectPlan& plan) const
+{
+    std::vector<DocId> result;
+    if (plan.steps.empty() || plan.steps[0].list.empty()) {
+        return result; // no terms, or one that occurs nowhere
+    }
+
+    if (plan.steps.size() > 1 && plan.steps[1].method == INTERSECT_BITMAP) {
+        size_t words = (plan.documentCount + 63) / 64;
+        std::vector<uint64_t> bits(words, 0);
+        for (PostingIterator it(plan.steps[0].list); !it.atEnd(); it.next()) {
+            bits[it.doc() / 64] |= uint64_t(1) << (it.doc() % 64);
+        }
+        std::vector<uint64_t> listBits(words);
+        for (size_t i = 1; i < plan.steps.size(); i++) {
+            std::fill(listBits.begin(), listBits.end(), 0);
+            for (PostingIterator it(plan.steps[i].list); !it.atEnd(); it.next()) {
+                listBits[it.doc() / 64] |= uint64_t(1) << (it.doc() % 64);
+            }
+            for (size_t w = 0; w < words; w++) {
+                bits[w] &= listBits[w];
+            }
+        }
+        for (size_t w = 0; w < words; w++) {
+            for (uint64_t word = bits[w]; word != 0; word &= word - 1) {
+                result.push_back(static_cast<DocId>(w * 64 + __builtin_ctzll(word)));
+            }
+        }
+        return result;
+    }
+
+    result.reserve(plan.steps[0].list.size());
+    for (PostingIterator it(plan.steps[0].list); !it.atEnd(); it.next()) {
+        result.push_back(it.doc());
+    }
+    std::vector<DocId> kept;
+    for (size_t i = 1; i < plan.steps.size() && !result.empty(); i++) {
+        PostingIterator it(plan.steps[i].list);
+        kept.clear();
+        if (plan.steps[i].method == INTERSECT_GALLOP) {
+            for (DocId doc : result) {
+                if (!it.advance(doc)) {
+                    break;
+                }
+                if (it.doc() == doc) {
+                    kept.push_back(doc);
+                }
+            }
+        } else {
+            size_t a = 0;
+            while (a < result.size() && !it.atEnd()) {
+                if (result[a] < it.doc()) {
+                    a++;
+                } else if (it.doc() < result[a]) {
+                    it.next();
+                } else {
+                    kept.push_back(result[a]);
+                    a++;
+                    it.next();
+                }
+            }
+        }
+        result.swap(kept);
+    }
+
+    return result;
+}
+
+std::vector<PhraseMatch> InvertedIndex::matchPhrase(const std::vector<std::string>& phraseTerms) const
+{
+    std::vector<PhraseMatch> result;
+    if (phraseTerms.empty()) {
+        return result;
+    }
+
+    std::vector<PostingList> lists;
+    for (const std::string& term : phraseTerms) {
+        PostingList list = postings(term);
+        if (list.empty()) {
+            return result;
+        }
+        lists.push_back(list);
+    }
+
+    // Only documents holding every term can hold the phrase.
+    std::vector<DocId> candidates = intersect(phraseTerms);
+    std::vector<PostingIterator> cursors;
+    cursors.reserve(lists.size());
+    for (const PostingList& list : lists) {
+        cursors.push_back(PostingIterator(list));
+    }
+    for (DocId doc : candidates) {
+        for (PostingIterator& cursor : cursors) {
+            cursor.advance(doc);
+        }
+
+        // Keep every occurrence of the first term that the rest line up behind.
+        PhraseMatch match;
+        match.doc = doc;
+        const uint32_t* firstPositions = cursors[0].positions();
+        const uint32_t* firstOffsets = cursors[0].offsets();
+        uint32_t firstCount = cursors[0].tf();
+        for (uint32_t i = 0; i < firstCount; i++) {
+            uint32_t position = firstPositions[i];
+            bool aligned = true;
+            for (size_t j = 1; j < cursors.size() && aligned; j++) {
+                const uint32_t* termPositions = cursors[j].positions();
+                aligned = std::binary_search(termPositions, termPositions + cursors[j].tf(),
+                                             position + static_cast<uint32_t>(j));
+            }
+            if (aligned) {
+                match.offsets.push_back(firstOffsets[i]);
+            }
+        }
+        if (!match.offsets.empty()) {
+            result.push_back(match);
+        }
+    }
+
+    return result;
+}
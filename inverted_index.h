@@ -0,0 +1,255 @@
+#ifndef INVERTED_INDEX_H
+#define INVERTED_INDEX_H
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+#include "index_file.h"
+
+// Dense document identifier assigned at crawl time (position in sorted URL order).
+typedef uint32_t DocId;
+
+// A word token: byte offset and length of a letter/digit run in some text.
+struct TermSpan
+{
+    uint32_t offset;
+    uint32_t length;
+};
+
+// One entry of a postings list: a document, how often the term occurs in it,
+// and where. positions[i] is the token number of the i-th occurrence and
+// offsets[i] the byte offset of that occurrence in the indexed text.
+struct Posting
+{
+    DocId doc;
+    uint32_t tf;
+    std::vector<uint32_t> positions;
+    std::vector<uint32_t> offsets;
+};
+
+// Documents in which a phrase's terms occur at consecutive positions, with the
+// byte offset of the first term for every such alignment.
+struct PhraseMatch
+{
+    DocId doc;
+    std::vector<uint32_t> offsets;
+};
+
+// Split text into index terms: maximal runs of ASCII letters/digits, lowercased.
+// These are exactly the units findWord() treats as standalone words.
+std::vector<std::string> splitTerms(const std::string& text);
+
+// True if text is a single index term as typed: non-empty and letters/digits only.
+bool isSingleTerm(const std::string& text);
+
+// Postings are compressed in blocks of this many entries.
+const size_t POSTING_BLOCK_SIZE = 128;
+
+// Skip entry of one block of a postings list. Every block but a list's last
+// holds POSTING_BLOCK_SIZE postings. Its data is four StreamVByte streams
+// (stream_vbyte.h), one after the other: document deltas (the first from the
+// previous block's last document, or from 0), term frequencies, and the
+// position and byte offset deltas of every occurrence (restarting at 0 in
+// each document). lastDoc lets a search skip the block without decoding it.
+struct PostingBlock
+{
+    uint64_t data;          // byte offset of the block's streams
+    DocId lastDoc;
+    uint32_t occurrences;   // sum of the block's term frequencies
+    uint32_t docBytes;
+    uint32_t tfBytes;
+    uint32_t positionBytes;
+    uint32_t offsetBytes;
+};
+
+// Read-only view of one term's postings list in a frozen index; read it with
+// a PostingIterator.
+class PostingList
+{
+public:
+    PostingList() : blocks(nullptr), data(nullptr), count(0), density(0) {}
+    PostingList(const PostingBlock* blocks, const uint8_t* data, size_t count, double density)
+        : blocks(blocks), data(data), count(count), density(density) {}
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    size_t blockCount() const { return (count + POSTING_BLOCK_SIZE - 1) / POSTING_BLOCK_SIZE; }
+
+    // Largest tf / (length of the indexed text) over the list's documents.
+    double maxDensity() const { return density; }
+
+private:
+    friend class PostingIterator;
+
+    const PostingBlock* blocks;
+    const uint8_t* data;
+    size_t count;
+    double density;
+};
+
+// Forward cursor over a postings list that decodes one block at a time.
+// Document ids are decoded when the cursor enters a block; frequencies and
+// occurrences only when asked for, and advance() passes over every block
+// whose last document is below its target without decoding it.
+class PostingIterator
+{
+public:
+    PostingIterator() : block(0), entry(0), entries(0), frequenciesDecoded(false), occurrencesDecoded(false) {}
+    explicit PostingIterator(const PostingList& list);
+
+    bool atEnd() const { return entry == entries; }
+    DocId doc() const { return docs[entry]; }
+    uint32_t tf();
+    // The positions/byte offsets of the current document's tf() occurrences;
+    // valid until the cursor moves.
+    const uint32_t* positions();
+    const uint32_t* offsets();
+
+    void next()
+    {
+        if (++entry == entries) decodeBlock(block + 1);
+    }
+
+    // Move forward to the first posting whose document is >= target. Returns
+    // false if there is none.
+    bool advance(DocId target);
+
+private:
+    void decodeBlock(size_t b);
+    void decodeFrequencies();
+    void decodeOccurrences();
+
+    PostingList list;
+    size_t block;
+    size_t entry;
+    size_t entries; // postings in the current block, 0 past the end
+    bool frequenciesDecoded;
+    bool occurrencesDecoded;
+    uint32_t docs[POSTING_BLOCK_SIZE];
+    uint32_t frequencies[POSTING_BLOCK_SIZE];
+    uint32_t occurrenceStart[POSTING_BLOCK_SIZE + 1];
+    std::vector<uint32_t> positionData;
+    std::vector<uint32_t> offsetData;
+};
+
+// How one postings list is combined with the documents left by the lists
+// before it (see InvertedIndex::planIntersection).
+enum IntersectMethod
+{
+    INTERSECT_DRIVE,  // the first, shortest list: its documents are the start
+    INTERSECT_MERGE,  // decode the list in full and merge
+    INTERSECT_GALLOP, // look each remaining document up, skipping blocks
+    INTERSECT_BITMAP  // AND the list into a bitmap of all documents
+};
+
+struct IntersectStep
+{
+    std::string term;
+    PostingList list;
+    IntersectMethod method;
+};
+
+// Terms of an AND query, rarest first, each with how it is intersected.
+struct IntersectPlan
+{
+    std::vector<IntersectStep> steps;
+    size_t documentCount; // corpus size the choice was made for
+};
+
+// Term -> postings index built once per crawl. Documents must be added in
+// increasing DocId order so every postings list stays sorted by document.
+// freeze() then flattens the lists into sorted arrays, which is the form
+// queries run against and the form saved to (and mapped back from) disk.
+// A frozen index can be patched for a recrawl: beginUpdate() renumbers the
+// documents it holds and drops some, addDocument() adds the new and changed
+// ones, and freeze() merges both into lists equal to those of a full build.
+class InvertedIndex
+{
+public:
+    InvertedIndex() : updating(false), documentTotal(0) {}
+
+    void clear();
+    void addDocument(DocId doc, std::string_view text);
+    void addDocument(DocId doc, std::string_view text, const std::vector<TermSpan>& tokens);
+
+    // Start patching the frozen index. remap[d] is the new DocId of indexed
+    // document d, or DocumentTable::NO_DOC to drop its postings; new ids must
+    // keep the order of the old ones. lengths[d] is the indexed text length
+    // of every new document, as addDocument() would record it.
+    void beginUpdate(std::vector<DocId> remap, std::vector<uint32_t> lengths);
+
+    // Flatten the lists built by addDocument() into the query layout, merged
+    // with the frozen lists after beginUpdate().
+    void freeze();
+
+    // Write the frozen index to an index directory, or map it back in
+    // (already frozen) for a corpus of 'documentCount' documents; load()
+    // rejects files of another build (see index_file.h).
+    void save(const std::string& directory, uint64_t build) const;
+    void load(const std::string& directory, size_t documentCount, uint64_t build);
+
+    // Postings for a (lowercase) term; empty if no document contains it.
+    PostingList postings(const std::string& term) const;
+
+    // Documents containing every term, in increasing DocId order.
+    std::vector<DocId> intersect(const std::vector<std::string>& terms) const;
+
+    // Cost-based plan for intersect(): distinct terms ordered by document
+    // frequency, so the running result only shrinks, and per list the
+    // cheapest way to combine it. A list much longer than the documents
+    // still in play is galloped through via its skip entries; one of similar
+    // length is merged; when even the rarest list covers a large share of the
+    // corpus, all lists are ANDed as bitmaps instead.
+    IntersectPlan planIntersection(const std::vector<std::string>& terms) const;
+    std::vector<DocId> intersect(const IntersectPlan& plan) const;
+
+    // Position-aligned intersection: documents where terms[0], terms[1], ...
+    // occur as consecutive tokens, in increasing DocId order.
+    std::vector<PhraseMatch> matchPhrase(const std::vector<std::string>& terms) const;
+
+    size_t termCount() const { return termStart.size() == 0 ? building.size() : termStart.size() - 1; }
+    // Term t of the frozen dictionary, in sorted order.
+    std::string_view term(size_t t) const
+    {
+        return std::string_view(termText.data() + termStart[t], static_cast<size_t>(termStart[t + 1] - termStart[t]));
+    }
+
+    // Size of the frozen postings: entries, occurrences, and bytes of skip
+    // entries plus compressed streams.
+    size_t postingCount() const { return postingStart.size() == 0 ? 0 : static_cast<size_t>(postingStart[postingStart.size() - 1]); }
+    size_t occurrenceCount() const;
+    size_t postingBytes() const { return blocks.size() * sizeof(PostingBlock) + postingData.size(); }
+
+private:
+    // Lists under construction and the length of every indexed text,
+    // released by freeze().
+    std::unordered_map<std::string, std::vector<Posting> > building;
+    std::vector<uint32_t> textLength;
+
+    // Renumbering of the frozen documents while an update is under way.
+    std::vector<DocId> documentRemap;
+    bool updating;
+
+    size_t documentTotal; // documents of the frozen index
+
+    // Frozen layout. Terms are sorted; term t is termText[termStart[t],
+    // termStart[t + 1]) and has postingStart[t + 1] - postingStart[t] postings,
+    // compressed into blocks [blockStart[t], blockStart[t + 1]) whose streams
+    // are in postingData. maxDensity[t] bounds how densely term t occurs in
+    // any one document.
+    StoredArray<char> termText;
+    StoredArray<uint64_t> termStart;
+    StoredArray<uint64_t> postingStart;
+    StoredArray<uint64_t> blockStart;
+    StoredArray<double> maxDensity;
+    StoredArray<PostingBlock> blocks;
+    StoredArray<uint8_t> postingData;
+
+    // Backing files of a loaded index.
+    MappedFile termsFile;
+    MappedFile postingsFile;
+};
+
+#endif // INVERTED_INDEX_H
@@ -0,0 +1,213 @@
+#include "keyword_matcher.h"
+#include "text_search.h"
+#include <cctype>
+#include <cstring>
+
+#if defined(__SSE2__)
+#define KEYWORD_MATCHER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+static inline unsigned char foldByte(unsigned char c, bool fold)
+{
+    return fold ? static_cast<unsigned char>(std::tolower(c)) : c;
+}
+
+KeywordMatcher::KeywordMatcher(const std::vector<std::string>& keywords, bool foldCase)
+    : keywords(keywords), foldCase(foldCase)
+{
+    // Column 0 is every byte that occurs in no keyword.
+    uint8_t foldedColumn[256] = {0};
+    size_t columns = 1;
+    for (const std::string& keyword : keywords) {
+        for (char c : keyword) {
+            unsigned char folded = foldByte(static_cast<unsigned char>(c), foldCase);
+            if (foldedColumn[folded] == 0) {
+                foldedColumn[folded] = static_cast<uint8_t>(columns++);
+            }
+        }
+    }
+    for (int c = 0; c < 256; c++) {
+        byteColumn[c] = foldedColumn[foldByte(static_cast<unsigned char>(c), foldCase)];
+    }
+    rowWidth = columns + 1;
+
+    // Trie of the folded keywords; 0 marks a missing child, since nothing
+    // leads back to the root while the trie is built.
+    std::vector<std::vector<uint32_t> > ending(1);
+    table.assign(rowWidth, 0);
+    for (size_t k = 0; k < keywords.size(); k++) {
+        if (keywords[k].empty()) continue;
+        uint32_t row = 0;
+        for (char c : keywords[k]) {
+            uint32_t& child = table[row + byteColumn[static_cast<unsigned char>(c)]];
+            if (child == 0) {
+                child = static_cast<uint32_t>(table.size());
+                table.resize(table.size() + rowWidth, 0);
+                ending.push_back(std::vector<uint32_t>());
+            }
+            row = table[row + byteColumn[static_cast<unsigned char>(c)]];
+        }
+        ending[row / rowWidth].push_back(static_cast<uint32_t>(k));
+    }
+
+    // Breadth-first, fill in every missing transition from the failure state
+    // (the longest proper suffix that is also a trie state), which was
+    // completed earlier, and inherit its keywords.
+    size_t states = table.size() / rowWidth;
+    std::vector<uint32_t> failure(states, 0);
+    std::vector<uint32_t> queue;
+    for (size_t c = 0; c < columns; c++) {
+        if (table[c] != 0) {
+            queue.push_back(table[c]);
+        }
+    }
+    for (size_t next = 0; next < queue.size(); next++) {
+        uint32_t row = queue[next];
+        uint32_t fail = failure[row / rowWidth];
+        const std::vector<uint32_t>& inherited = ending[fail / rowWidth];
+        ending[row / rowWidth].insert(ending[row / rowWidth].end(), inherited.begin(), inherited.end());
+        for (size_t c = 0; c < columns; c++) {
+            uint32_t& child = table[row + c];
+            if (child != 0) {
+                failure[child / rowWidth] = table[fail + c];
+                queue.push_back(child);
+            } else {
+                child = table[fail + c];
+            }
+        }
+    }
+
+    startCount = 0;
+    for (int c = 0; c < 256; c++) {
+        startByte[c] = table[byteColumn[c]] != 0;
+        if (startByte[c]) {
+            if (startCount < sizeof(startBytes)) {
+                startBytes[startCount] = static_cast<uint8_t>(c);
+            }
+            startCount++;
+        }
+    }
+    // Unused slots repeat a start byte, so the vector loop always compares four.
+    for (size_t i = startCount; i < sizeof(startBytes); i++) {
+        startBytes[i] = startCount == 0 ? 0 : startBytes[0];
+    }
+
+    // Renumber the states so the ones that end a keyword come last: the scan
+    // then tells them apart with one comparison of the row it already has.
+    std::vector<uint32_t> order;
+    for (size_t s = 0; s < states; s++) {
+        if (ending[s].empty()) order.push_back(static_cast<uint32_t>(s));
+    }
+    acceptingRows = static_cast<uint32_t>(order.size() * rowWidth);
+    for (size_t s = 0; s < states; s++) {
+        if (!ending[s].empty()) order.push_back(static_cast<uint32_t>(s));
+    }
+    std::vector<uint32_t> renumbered(states);
+    for (size_t n = 0; n < states; n++) {
+        renumbered[order[n]] = static_cast<uint32_t>(n * rowWidth);
+    }
+    std::vector<uint32_t> trie;
+    trie.swap(table);
+    table.assign((states + 1) * rowWidth, 0);
+    for (size_t n = 0; n < states; n++) {
+        size_t s = order[n];
+        for (size_t c = 0; c < columns; c++) {
+            table[n * rowWidth + c] = renumbered[trie[s * rowWidth + c] / rowWidth];
+        }
+        table[n * rowWidth + columns] = static_cast<uint32_t>(outputs.size());
+        outputs.insert(outputs.end(), ending[s].begin(), ending[s].end());
+    }
+    table[states * rowWidth + columns] = static_cast<uint32_t>(outputs.size());
+}
+
+// Position of the first byte at or after 'i' that can begin a keyword, or 'length'.
+size_t KeywordMatcher::nextStart(const unsigned char* bytes, size_t i, size_t length) const
+{
+    if (startCount == 0) return length;
+#ifdef KEYWORD_MATCHER_SSE2
+    if (startCount <= sizeof(startBytes)) {
+        const __m128i first = _mm_set1_epi8(static_cast<char>(startBytes[0]));
+        const __m128i second = _mm_set1_epi8(static_cast<char>(startBytes[1]));
+        const __m128i third = _mm_set1_epi8(static_cast<char>(startBytes[2]));
+        const __m128i fourth = _mm_set1_epi8(static_cast<char>(startBytes[3]));
+        for (; i + 16 <= length; i += 16) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+            __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, first), _mm_cmpeq_epi8(chunk, second)),
+                                        _mm_or_si128(_mm_cmpeq_epi8(chunk, third), _mm_cmpeq_epi8(chunk, fourth)));
+            int mask = _mm_movemask_epi8(hits);
+            if (mask != 0) {
+                return i + static_cast<size_t>(__builtin_ctz(static_cast<unsigned>(mask)));
+            }
+        }
+    }
+#endif
+    while (i < length && !startByte[bytes[i]]) {
+        i++;
+    }
+    return i;
+}
+
+void KeywordMatcher::scan(std::string_view text, KeywordMatches& matches) const
+{
+    matches.exactCounts.assign(keywords.size(), 0);
+    matches.firstMatch.assign(keywords.size(), std::string::npos);
+    matches.exactEnd.assign(keywords.size(), 0);
+
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(text.data());
+    const size_t length = text.size();
+
+    if (!foldCase && keywords.size() == 1) {
+        // A single exact keyword: the library's memchr-based find is faster
+        // than stepping the automaton through every candidate.
+        const std::string& keyword = keywords[0];
+        if (keyword.empty()) return;
+        size_t pos = 0;
+        while ((pos = text.find(keyword, pos)) != std::string::npos) {
+            size_t end = pos + keyword.size();
+            if ((pos == 0 || !isWordByte(bytes[pos - 1])) && (end == length || !isWordByte(bytes[end]))) {
+                if (matches.exactCounts[0]++ == 0) {
+                    matches.firstMatch[0] = pos;
+                }
+                pos = end;
+            } else {
+                pos++;
+            }
+        }
+        return;
+    }
+
+    const size_t outputColumn = rowWidth - 1;
+    const uint32_t* rows = table.data();
+    const uint8_t* column = byteColumn;
+    const uint32_t accepting = acceptingRows;
+    uint32_t row = 0;
+    for (size_t i = 0; i < length; i++) {
+        if (row == 0) {
+            // Outside any keyword, only look for a byte that can start one.
+            i = nextStart(bytes, i, length);
+            if (i == length) break;
+        }
+        row = rows[row + column[bytes[i]]];
+        if (row < accepting) continue;
+        uint32_t first = rows[row + outputColumn];
+        uint32_t last = rows[row + rowWidth + outputColumn];
+
+        size_t end = i + 1;
+        if (end < length && isWordByte(bytes[end])) continue;
+        for (uint32_t o = first; o < last; o++) {
+            uint32_t k = outputs[o];
+            const std::string& keyword = keywords[k];
+            size_t start = end - keyword.size();
+            if (start > 0 && isWordByte(bytes[start - 1])) continue;
+            if (matches.firstMatch[k] == std::string::npos) {
+                matches.firstMatch[k] = start;
+            }
+            if (start >= matches.exactEnd[k] &&
+                std::memcmp(bytes + start, keyword.data(), keyword.size()) == 0) {
+                matches.exactCounts[k]++;
+                matches.exactEnd[k] = end;
+            }
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef KEYWORD_MATCHER_H
+#define KEYWORD_MATCHER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// What one KeywordMatcher::scan() found, per keyword in the order they were
+// given to the matcher.
+struct KeywordMatches
+{
+    // Case-sensitive whole-word occurrences, counted left to right without
+    // overlapping each other (what countExactOccurrences() counts).
+    std::vector<int> exactCounts;
+    // Offset of the first whole-word occurrence, or std::string::npos. With
+    // case folding this is what findWord() and findPhrase() return; without,
+    // it is the first of the occurrences exactCounts counts.
+    std::vector<size_t> firstMatch;
+
+    bool found(size_t keyword) const { return firstMatch[keyword] != std::string::npos; }
+
+private:
+    friend class KeywordMatcher;
+    std::vector<size_t> exactEnd; // end of the last counted occurrence
+};
+
+// Aho-Corasick automaton over a fixed set of keywords, compiled once per query
+// so that a single pass over a document finds every keyword instead of one
+// pass per keyword. Like the rest of the search, a whole word is one whose
+// neighbouring characters are not ASCII letters or digits; empty keywords
+// never match.
+//
+// With 'foldCase' the automaton matches case-insensitively, and a
+// case-sensitive occurrence is a case-insensitive one whose bytes are also
+// equal. Without it only exact occurrences are followed, which keeps the scan
+// out of the many lowercase near-misses when only exactCounts is needed. Only
+// the bytes that occur in some keyword get their own column in the transition
+// table; every other byte shares one, so the table stays small for any query.
+// Outside a keyword, the scan jumps to the next byte that can start one, 16
+// bytes at a time with SSE2 when there are at most four such bytes. A single
+// exact keyword is found with std::string_view::find() instead.
+class KeywordMatcher
+{
+public:
+    explicit KeywordMatcher(const std::vector<std::string>& keywords, bool foldCase = false);
+
+    size_t size() const { return keywords.size(); }
+    const std::string& keyword(size_t i) const { return keywords[i]; }
+
+    // Find every keyword in 'text'; 'matches' is overwritten.
+    void scan(std::string_view text, KeywordMatches& matches) const;
+
+private:
+    size_t nextStart(const unsigned char* bytes, size_t i, size_t length) const;
+
+    std::vector<std::string> keywords;
+    bool foldCase;
+    uint8_t byteColumn[256]; // column of every byte (by its lowercase form when folding)
+    bool startByte[256];     // bytes that can begin a keyword
+    uint8_t startBytes[4];   // the same as a list, when there are at most four
+    size_t startCount;
+    size_t rowWidth;         // columns plus the output column
+    // Row r * rowWidth holds state r's transitions, already multiplied by
+    // rowWidth, and in its last column the start of the state's keywords in
+    // 'outputs'; a final row closes the last range. The states that end some
+    // keyword are the rows from 'acceptingRows' on.
+    std::vector<uint32_t> table;
+    uint32_t acceptingRows;
+    std::vector<uint32_t> outputs; // keywords ending at each state, suffixes included
+};
+
+#endif // KEYWORD_MATCHER_H
@@ -0,0 +1,167 @@
+// Regression check for KeywordMatcher: scans generated texts for generated
+// keyword sets, with and without case folding, and compares every keyword's
+// count and first match with a search for that keyword alone (the way
+// countExactOccurrences() and findWord() search). Texts and keywords are
+// drawn from a few bytes, so keywords overlap, share prefixes and suffixes
+// and repeat. Exits with status 1 on any difference.
+//
+//   ./keyword_matcher_check.exe [--cases N] [--seed X]
+
+#include "keyword_matcher.h"
+#include <cctype>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// splitmix64, so the same seed checks the same cases everywhere.
+static uint64_t nextRandom(uint64_t& state)
+{
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// ===================================================
+// REFERENCE
+// ===================================================
+
+static bool wholeWordAt(const std::string& text, size_t pos, size_t length)
+{
+    bool validBefore = pos == 0 || !std::isalnum(static_cast<unsigned char>(text[pos - 1]));
+    bool validAfter = pos + length == text.size() || !std::isalnum(static_cast<unsigned char>(text[pos + length]));
+    return validBefore && validAfter;
+}
+
+// Non-overlapping case-sensitive whole-word occurrences, as countExactOccurrences().
+static int referenceCount(const std::string& text, const std::string& keyword, size_t& first)
+{
+    first = std::string::npos;
+    if (keyword.empty()) return 0;
+    int count = 0;
+    size_t pos = 0;
+    while ((pos = text.find(keyword, pos)) != std::string::npos) {
+        if (wholeWordAt(text, pos, keyword.size())) {
+            if (count++ == 0) first = pos;
+            pos += keyword.size();
+        } else {
+            pos++;
+        }
+    }
+    return count;
+}
+
+static std::string lowercase(std::string text)
+{
+    for (char& c : text) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return text;
+}
+
+// First case-insensitive whole-word occurrence, as findWord().
+static size_t referenceFind(const std::string& text, const std::string& keyword)
+{
+    if (keyword.empty()) return std::string::npos;
+    std::string lowerText = lowercase(text);
+    std::string lowerKeyword = lowercase(keyword);
+    for (size_t pos = 0; (pos = lowerText.find(lowerKeyword, pos)) != std::string::npos; pos++) {
+        if (wholeWordAt(lowerText, pos, lowerKeyword.size())) return pos;
+    }
+    return std::string::npos;
+}
+
+// ===================================================
+// CASES
+// ===================================================
+
+// Mostly keyword bytes; 'sparse' texts are mostly bytes no keyword has, so
+// the scan spends its time jumping to the next possible start.
+static std::string makeText(uint64_t& random, const std::string& alphabet, size_t length, bool sparse)
+{
+    static const char filler[] = "xyz XYZ,;\x80\xff";
+    std::string text;
+    for (size_t i = 0; i < length; i++) {
+        uint64_t r = nextRandom(random);
+        if (sparse ? r % 16 != 0 : r % 8 == 0) {
+            text += filler[(r >> 8) % (sizeof(filler) - 1)];
+        } else {
+            text += alphabet[(r >> 8) % alphabet.size()];
+        }
+    }
+    return text;
+}
+
+int main(int argc, char** argv)
+{
+    size_t cases = 20000;
+    uint64_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (arg == "--cases") {
+            cases = std::strtoul(value.c_str(), nullptr, 10);
+        } else if (arg == "--seed") {
+            seed = std::strtoull(value.c_str(), nullptr, 10);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--cases N] [--seed X]" << std::endl;
+            return 1;
+        }
+    }
+
+    // Small alphabets give few start bytes (the SSE2 skip), larger ones more.
+    static const char* const alphabets[] = { "aA", "aA ", "abAB .", "abcABC :.1-", "ab:Ab. 1\xe9" };
+    size_t failures = 0;
+    size_t occurrences = 0;
+    try {
+        uint64_t random = seed;
+        KeywordMatches matches;
+        for (size_t c = 0; c < cases; c++) {
+            std::string alphabet = alphabets[nextRandom(random) % 5];
+            std::vector<std::string> keywords(1 + nextRandom(random) % 6);
+            for (std::string& keyword : keywords) {
+                keyword = makeText(random, alphabet, nextRandom(random) % 5, false);
+            }
+            if (keywords.size() > 1 && nextRandom(random) % 4 == 0) {
+                keywords[1] = keywords[0];
+            }
+            size_t length = nextRandom(random) % 8 == 0 ? 1000 + nextRandom(random) % 1000 : nextRandom(random) % 120;
+            std::string text = makeText(random, alphabet, length, nextRandom(random) % 3 == 0);
+
+            for (bool foldCase : { false, true }) {
+                KeywordMatcher matcher(keywords, foldCase);
+                matcher.scan(text, matches);
+                bool same = matches.exactCounts.size() == keywords.size() && matches.firstMatch.size() == keywords.size();
+                for (size_t k = 0; same && k < keywords.size(); k++) {
+                    size_t first;
+                    int count = referenceCount(text, keywords[k], first);
+                    if (foldCase) first = referenceFind(text, keywords[k]);
+                    same = matches.exactCounts[k] == count && matches.firstMatch[k] == first;
+                    occurrences += count;
+                }
+                if (!same && failures++ < 10) {
+                    std::cout << "DIFFERS in case " << c << (foldCase ? " (folding case)" : "") << ": keywords";
+                    for (const std::string& keyword : keywords) {
+                        std::cout << " \"" << keyword << "\"";
+                    }
+                    std::cout << " in \"" << text << "\"" << std::endl;
+                }
+            }
+        }
+        std::cout << "Matcher: " << cases << " cases, " << occurrences << " occurrences checked" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return 1;
+    }
+    if (failures > 0) {
+        std::cout << failures << " scans differ" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include "link_graph.h"
+#include <algorithm>
+
+void LinkGraph::clear()
+{
+    degree.clear();
+    incomingStart.clear();
+    incomingLinks.clear();
+    outgoingStart.clear();
+    outgoingLinks.clear();
+    backlinks.clear();
+    rank.clear();
+    maxBacklinks = 0.0;
+    maxRank = 0.0;
+    linksFile.close();
+}
+
+// Concatenate the rows of 'lists' into CSR form.
+static void flatten(const std::vector<std::vector<DocId> >& lists, StoredArray<uint64_t>& start, StoredArray<DocId>& links)
+{
+    std::vector<uint64_t> rowStart(1, 0);
+    std::vector<DocId> flat;
+    for (const std::vector<DocId>& list : lists) {
+        flat.insert(flat.end(), list.begin(), list.end());
+        rowStart.push_back(flat.size());
+    }
+    start.assign(std::move(rowStart));
+    links.assign(std::move(flat));
+}
+
+void LinkGraph::build(const std::vector<std::vector<DocId> >& incoming,
+                      const std::vector<std::vector<DocId> >& outgoing,
+                      const std::vector<uint32_t>& outDegree)
+{
+    clear();
+    degree.assign(std::vector<uint32_t>(outDegree));
+    flatten(incoming, incomingStart, incomingLinks);
+    flatten(outgoing, outgoingStart, outgoingLinks);
+    computeBacklinksScores();
+}
+
+void LinkGraph::setPageRank(const std::vector<double>& ranks)
+{
+    std::vector<double> scaled(ranks.size());
+    maxRank = 0.0;
+    for (size_t doc = 0; doc < ranks.size(); doc++) {
+        scaled[doc] = ranks[doc] * ranks.size();
+        maxRank = std::max(maxRank, scaled[doc]);
+    }
+    rank.assign(std::move(scaled));
+}
+
+void LinkGraph::computeBacklinksScores()
+{
+    std::vector<double> scores(size(), 0.0);
+    for (DocId doc = 0; doc < size(); doc++) {
+        double score = 0.0;
+        for (DocId backlink : incoming(doc)) {
+            // Use the actual outgoing link count (do not cap it)
+            size_t outgoingLinkCount = degree[backlink];
+            score += 1.0 / (1.0 + outgoingLinkCount);
+        }
+        scores[doc] = score;
+        maxBacklinks = std::max(maxBacklinks, score);
+    }
+    backlinks.assign(std::move(scores));
+}
+
+void LinkGraph::save(const std::string& directory, uint64_t build) const
+{
+    IndexFileWriter out(indexFilePath(directory, SECTION_LINKS), SECTION_LINKS, build);
+    out.writeArray(degree.data(), degree.size());
+    out.writeArray(incomingStart.data(), incomingStart.size());
+    out.writeArray(incomingLinks.data(), incomingLinks.size());
+    out.writeArray(outgoingStart.data(), outgoingStart.size());
+    out.writeArray(outgoingLinks.data(), outgoingLinks.size());
+    out.writeArray(backlinks.data(), backlinks.size());
+    out.writeArray(rank.data(), rank.size());
+    out.finish();
+}
+
+// Check that a CSR row table over 'count' rows stays inside 'links' and only
+// names known documents.
+static bool validRows(const StoredArray<uint64_t>& start, const StoredArray<DocId>& links, size_t count)
+{
+    if (start.size() != count + 1 || start[0] != 0 || start[count] != links.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (start[i] > start[i + 1]) return false;
+    }
+    for (size_t i = 0; i < links.size(); i++) {
+        if (links[i] >= count) return false;
+    }
+    return true;
+}
+
+void LinkGraph::load(const std::string& directory, size_t documentCount, uint64_t build)
+{
+    clear();
+    IndexFileReader in(linksFile, indexFilePath(directory, SECTION_LINKS), SECTION_LINKS);
+    in.expectBuild(build);
+    in.readArray(degree);
+    in.readArray(incomingStart);
+    in.readArray(incomingLinks);
+    in.readArray(outgoingStart);
+    in.readArray(outgoingLinks);
+    in.readArray(backlinks);
+    in.readArray(rank);
+    in.finish();
+
+    if (degree.size() != documentCount || backlinks.size() != documentCount || rank.size() != documentCount ||
+        !validRows(incomingStart, incomingLinks, documentCount) ||
+        !validRows(outgoingStart, outgoingLinks, documentCount)) {
+        in.fail("link graph does not match the document table");
+    }
+    for (DocId doc = 0; doc < documentCount; doc++) {
+        maxBacklinks = std::max(maxBacklinks, backlinks[doc]);
+        maxRank = std::max(maxRank, rank[doc]);
+    }
+}
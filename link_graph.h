@@ -0,0 +1,86 @@
+#ifndef LINK_GRAPH_H
+#define LINK_GRAPH_H
+
+#include <string>
+#include <vector>
+#include "inverted_index.h"
+#include "index_file.h"
+#include "mapped_file.h"
+
+// The DocIds of one row of the link graph.
+struct DocRange
+{
+    const DocId* first;
+    const DocId* last;
+
+    const DocId* begin() const { return first; }
+    const DocId* end() const { return last; }
+    size_t size() const { return static_cast<size_t>(last - first); }
+};
+
+// Link graph between crawled documents, frozen after the crawl into
+// compressed sparse row arrays: document d's incoming links are
+// incomingLinks[incomingStart[d], incomingStart[d + 1]), and likewise for
+// outgoing links. Rows are sorted by DocId. The backlinks score of every
+// document is computed once when the graph is built, so ranking only has to
+// read it.
+class LinkGraph
+{
+public:
+    LinkGraph() : maxBacklinks(0.0), maxRank(0.0) {}
+
+    void clear();
+
+    // Freeze per-document link lists. outDegree counts every distinct link
+    // target other than the document itself, crawled or not; the lists only
+    // hold crawled documents, sorted and without repeats.
+    void build(const std::vector<std::vector<DocId> >& incoming,
+               const std::vector<std::vector<DocId> >& outgoing,
+               const std::vector<uint32_t>& outDegree);
+
+    // Write the graph to an index directory, or map it back in for a corpus
+    // of 'documentCount' documents; load() rejects a file of another build.
+    void save(const std::string& directory, uint64_t build) const;
+    void load(const std::string& directory, size_t documentCount, uint64_t build);
+
+    size_t size() const { return degree.size(); }
+    DocRange incoming(DocId doc) const { return row(incomingStart, incomingLinks, doc); }
+    DocRange outgoing(DocId doc) const { return row(outgoingStart, outgoingLinks, doc); }
+    uint32_t outDegree(DocId doc) const { return degree[doc]; }
+
+    // Sum over the documents linking to 'doc' (itself included) of
+    // 1 / (1 + their out-degree).
+    double backlinksScore(DocId doc) const { return backlinks[doc]; }
+    double maxBacklinksScore() const { return maxBacklinks; }
+
+    // PageRank of every document (see pagerank.h), scaled by the number of
+    // documents so the average document scores 1 like a typical backlinks
+    // score does. Set once per crawl, after build().
+    void setPageRank(const std::vector<double>& ranks);
+    double pageRank(DocId doc) const { return rank[doc]; }
+    double maxPageRank() const { return maxRank; }
+
+private:
+    static DocRange row(const StoredArray<uint64_t>& start, const StoredArray<DocId>& links, DocId doc)
+    {
+        DocRange range;
+        range.first = links.data() + start[doc];
+        range.last = links.data() + start[doc + 1];
+        return range;
+    }
+    void computeBacklinksScores();
+
+    StoredArray<uint32_t> degree;
+    StoredArray<uint64_t> incomingStart;
+    StoredArray<DocId> incomingLinks;
+    StoredArray<uint64_t> outgoingStart;
+    StoredArray<DocId> outgoingLinks;
+    StoredArray<double> backlinks;
+    StoredArray<double> rank;
+    double maxBacklinks;
+    double maxRank;
+
+    MappedFile linksFile; // backing file of a loaded graph
+};
+
+#endif // LINK_GRAPH_H
@@ -0,0 +1,202 @@
+#include "link_resolver.h"
+#include "metrics.h"
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <cctype>
+#include <cstring>
+#include <vector>
+
+LinkResolver::LinkResolver() : shards(new Shard[SHARDS]) {}
+
+void LinkResolver::reset(const std::string& root)
+{
+    for (size_t i = 0; i < SHARDS; i++) {
+        std::lock_guard<std::mutex> guard(shards[i].lock);
+        shards[i].resolved.clear();
+    }
+    directories.clear();
+    if (!root.empty()) {
+        scan(root);
+    }
+}
+
+// One readdir() pass over every directory below 'root'. Entries whose type
+// readdir() does not give (symbolic links, some filesystems) are stat()ed;
+// symbolic links to directories are not descended into, so a link cycle
+// cannot make the scan loop and paths below them fall back to stat().
+void LinkResolver::scan(const std::string& root)
+{
+    std::vector<std::string> pending(1, root);
+    while (!pending.empty()) {
+        std::string directory = pending.back();
+        pending.pop_back();
+        DIR* listing = opendir(directory.c_str());
+        if (listing == nullptr) {
+            continue;
+        }
+        Listing& listed = directories[directory];
+        while (struct dirent* entry = readdir(listing)) {
+            if (std::strcmp(entry->d_name, ".") == 0 || std::strcmp(entry->d_name, "..") == 0) {
+                continue;
+            }
+            std::string name = entry->d_name;
+            Entry type = ENTRY_FILE;
+            if (entry->d_type == DT_DIR) {
+                type = ENTRY_DIRECTORY;
+                pending.push_back(directory + name + "/");
+            } else if (entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN) {
+                std::string path = directory + name;
+                struct stat st;
+                METRIC_ADD(COUNTER_STAT_CALLS, 1);
+                if (entry->d_type == DT_UNKNOWN && lstat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+                    type = ENTRY_DIRECTORY;
+                    pending.push_back(path + "/");
+                } else if (stat(path.c_str(), &st) != 0) {
+                    type = ENTRY_MISSING; // dangling link
+                } else if (S_ISDIR(st.st_mode)) {
+                    type = ENTRY_DIRECTORY;
+                }
+            }
+            listed.entries[name] = type;
+            std::string folded = name;
+            for (char& c : folded) {
+                c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            }
+            if (folded != name) {
+                listed.foldedNames.insert(folded);
+            }
+        }
+        closedir(listing);
+    }
+}
+
+LinkResolver::Entry LinkResolver::entryAt(const std::string& path) const
+{
+    size_t slash = path.find_last_of('/');
+    if (slash != std::string::npos) {
+        std::unordered_map<std::string, Listing>::const_iterator listing = directories.find(path.substr(0, slash + 1));
+        if (listing != directories.end()) {
+            std::string name = path.substr(slash + 1);
+            std::unordered_map<std::string, Entry>::const_iterator entry = listing->second.entries.find(name);
+            if (entry != listing->second.entries.end()) {
+                return entry->second;
+            }
+            if (listing->second.foldedNames.count(name) == 0) {
+                return ENTRY_MISSING;
+            }
+        }
+    }
+    struct stat st;
+    METRIC_ADD(COUNTER_STAT_CALLS, 1);
+    if (stat(path.c_str(), &st) != 0) {
+        return ENTRY_MISSING;
+    }
+    return S_ISDIR(st.st_mode) ? ENTRY_DIRECTORY : ENTRY_FILE;
+}
+
+std::string LinkResolver::resolve(const std::string& basePath, const std::string& href)
+{
+    std::string_view baseDir(basePath.data(), basePath.find_last_of('/') + 1);
+    std::string key;
+    key.reserve(baseDir.size() + 1 + href.size());
+    key.append(baseDir.data(), baseDir.size());
+    key += '\0';
+    key += href;
+
+    Shard& shard = shards[std::hash<std::string>()(key) % SHARDS];
+    {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        std::unordered_map<std::string, std::string>::const_iterator it = shard.resolved.find(key);
+        if (it != shard.resolved.end()) {
+            METRIC_ADD(COUNTER_LINK_CACHE_HITS, 1);
+            return it->second;
+        }
+    }
+    std::string path = normalize(baseDir, href);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    shard.resolved.emplace(std::move(key), path);
+    return path;
+}
+
+static inline bool isSpace(char c)
+{
+    return std::isspace(static_cast<unsigned char>(c)) != 0;
+}
+
+std::string LinkResolver::normalize(std::string_view baseDir, std::string_view href) const
+{
+    size_t begin = 0;
+    size_t end = href.size();
+    while (begin < end && isSpace(href[begin])) begin++;
+    while (end > begin && isSpace(href[end - 1])) end--;
+
+    // Components are appended to the directory in place; each remembers the
+    // length before it so ".." can cut it off again.
+    std::string result(baseDir);
+    std::vector<size_t> componentStarts;
+    size_t pos = begin;
+    while (pos < end) {
+        size_t slash = href.find('/', pos);
+        if (slash == std::string_view::npos || slash > end) slash = end;
+        size_t first = pos;
+        size_t last = slash;
+        pos = slash + 1;
+        while (first < last && isSpace(href[first])) first++;
+        while (last > first && isSpace(href[last - 1])) last--;
+        size_t length = last - first;
+        if (length == 0 || (length == 1 && href[first] == '.')) {
+            continue;
+        }
+        if (length == 2 && href[first] == '.' && href[first + 1] == '.') {
+            if (!componentStarts.empty()) {
+                result.resize(componentStarts.back());
+                componentStarts.pop_back();
+            }
+            continue;
+        }
+        componentStarts.push_back(result.size());
+        if (result.empty() || result.back() != '/') {
+            result += '/';
+        }
+        for (size_t i = first; i < last; i++) {
+            result += static_cast<char>(std::tolower(static_cast<unsigned char>(href[i])));
+        }
+    }
+
+    // Collapse runs of slashes (only the page's directory can hold them).
+    size_t kept = 0;
+    for (size_t i = 0; i < result.size(); i++) {
+        if (result[i] != '/' || kept == 0 || result[kept - 1] != '/') {
+            result[kept++] = result[i];
+        }
+    }
+    result.resize(kept);
+
+    if (!result.empty() && result.back() == '/') {
+        result += "index.html";
+        return result;
+    }
+    size_t lastDot = result.find_last_of('.');
+    size_t lastSlash = result.find_last_of('/');
+    if (lastDot == std::string::npos || (lastSlash != std::string::npos && lastDot < lastSlash)) {
+        // No extension: a directory's index page, or an HTML file.
+        if (entryAt(result) == ENTRY_DIRECTORY) {
+            result += "/index.html";
+        } else {
+            result += ".html";
+        }
+    } else {
+        std::string extension = result.substr(lastDot);
+        for (char& c : extension) {
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+        if (extension != ".html") {
+            std::string htmlVersion = result.substr(0, lastDot) + ".html";
+            if (entryAt(htmlVersion) != ENTRY_MISSING) {
+                result = htmlVersion;
+            }
+        }
+    }
+    return result;
+}
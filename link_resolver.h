@@ -0,0 +1,73 @@
+#ifndef LINK_RESOLVER_H
+#define LINK_RESOLVER_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+// Turns the hrefs of a page into the paths the crawler fetches, for
+// Search::normalizePath(). An href is trimmed and lowercased and its
+// components are resolved against the page's directory: "." and empty
+// components are dropped, and ".." removes the previous component of the
+// href (never one of the page's directory). A path ending in '/' gets
+// "index.html"; a path without an extension becomes "<path>/index.html" if it
+// is a directory and "<path>.html" otherwise; and a path with another
+// extension is replaced by its ".html" twin when one exists.
+//
+// Results depend only on the page's directory and the raw href, so they are
+// cached on that pair: pages that share navigation resolve each link once.
+// The existence checks are answered from one scan of the crawl's root
+// directory tree instead of stat() calls; paths in directories the scan did
+// not list (outside the root, or below a symbolic link) and names that only
+// differ in case from a listed one still use stat().
+// Safe to call from several crawl threads at once.
+class LinkResolver
+{
+public:
+    LinkResolver();
+
+    // Forget every cached result and scan the directory tree below 'root',
+    // spelled the way crawl paths begin (e.g. "html_files/"); an empty root
+    // scans nothing.
+    void reset(const std::string& root);
+
+    std::string resolve(const std::string& basePath, const std::string& href);
+
+private:
+    enum Entry
+    {
+        ENTRY_MISSING,
+        ENTRY_FILE, // anything stat() finds that is not a directory
+        ENTRY_DIRECTORY
+    };
+
+    std::string normalize(std::string_view baseDir, std::string_view href) const;
+    // What is at 'path' (following symbolic links, like stat()): from the
+    // scan if it listed the path's directory, otherwise from stat().
+    Entry entryAt(const std::string& path) const;
+    void scan(const std::string& root);
+
+    static const size_t SHARDS = 64;
+    struct Shard
+    {
+        std::mutex lock;
+        std::unordered_map<std::string, std::string> resolved; // "<dir>\0<href>" -> path
+    };
+    std::unique_ptr<Shard[]> shards;
+
+    struct Listing
+    {
+        std::unordered_map<std::string, Entry> entries;
+        // Lowercased names of the entries with capitals: on a case-insensitive
+        // filesystem stat() finds those under a lowercased href as well.
+        std::unordered_set<std::string> foldedNames;
+    };
+    // Scanned directories (with their trailing '/'). Read-only between
+    // reset() calls.
+    std::unordered_map<std::string, Listing> directories;
+};
+
+#endif // LINK_RESOLVER_H
@@ -0,0 +1,257 @@
+// Regression check for LinkResolver: builds a small tree with symbolic
+// links, mixed-case names, extensionless files and directories and .php/.html
+// twins, then resolves generated hrefs from pages inside and outside it and
+// compares every result, first resolved and then from the cache, with the
+// stat()-based normalizePath() the resolver replaced (kept below as it was).
+// Exits with status 1 on any difference.
+//
+//   ./link_resolver_check.exe [--dir DIR] [--cases N] [--seed X]
+
+#include "link_resolver.h"
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// splitmix64, so the same seed checks the same links everywhere.
+static uint64_t nextRandom(uint64_t& state)
+{
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// ===================================================
+// REFERENCE
+// ===================================================
+
+static std::string referenceResolve(const std::string& basePath, const std::string& relativePath)
+{
+    std::string rel = relativePath;
+    while (!rel.empty() && std::isspace(rel.front())) {
+        rel.erase(rel.begin());
+    }
+    while (!rel.empty() && std::isspace(rel.back())) {
+        rel.pop_back();
+    }
+    std::transform(rel.begin(), rel.end(), rel.begin(), ::tolower);
+
+    std::string baseDir = basePath.substr(0, basePath.find_last_of('/') + 1);
+
+    std::vector<std::string> components;
+    std::istringstream iss(rel);
+    std::string token;
+    while (std::getline(iss, token, '/')) {
+        token.erase(token.begin(), std::find_if(token.begin(), token.end(), [](int ch) {
+            return !std::isspace(ch);
+        }));
+        token.erase(std::find_if(token.rbegin(), token.rend(), [](int ch) {
+            return !std::isspace(ch);
+        }).base(), token.end());
+
+        if (token.empty() || token == ".")
+            continue;
+        if (token == "..") {
+            if (!components.empty())
+                components.pop_back();
+        } else {
+            components.push_back(token);
+        }
+    }
+
+    std::string result = baseDir;
+    for (const std::string& comp : components) {
+        if (result.empty() || result.back() != '/')
+            result += '/';
+        result += comp;
+    }
+    result = std::regex_replace(result, std::regex("/{2,}"), "/");
+
+    if (!result.empty() && result.back() == '/') {
+        result += "index.html";
+    } else {
+        size_t lastDot = result.find_last_of('.');
+        size_t lastSlash = result.find_last_of('/');
+        if (lastDot == std::string::npos || (lastSlash != std::string::npos && lastDot < lastSlash)) {
+            struct stat st;
+            if (stat(result.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+                if (result.back() != '/')
+                    result += '/';
+                result += "index.html";
+            } else {
+                result += ".html";
+            }
+        } else {
+            std::string extension = result.substr(lastDot);
+            std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+            if (extension != ".html") {
+                std::string htmlVersion = result.substr(0, lastDot) + ".html";
+                struct stat st;
+                if (stat(htmlVersion.c_str(), &st) == 0) {
+                    result = htmlVersion;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+// ===================================================
+// TREE
+// ===================================================
+
+static void makeDirectory(const std::string& path)
+{
+    if (mkdir(path.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw std::runtime_error("cannot create " + path);
+    }
+}
+
+static void makeFile(const std::string& path)
+{
+    std::ofstream out(path, std::ios::trunc);
+    out << "<html><body></body></html>\n";
+    if (!out) {
+        throw std::runtime_error("cannot write " + path);
+    }
+}
+
+static void makeLink(const std::string& target, const std::string& path)
+{
+    std::remove(path.c_str());
+    if (symlink(target.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("cannot link " + path);
+    }
+}
+
+// The crawl root 'directory'/site/ and a page directory outside it.
+static void makeTree(const std::string& directory)
+{
+    std::string site = directory + "/site/";
+    makeDirectory(directory);
+    makeDirectory(site);
+    for (const char* path : { "sub", "sub/deep", "docs", "upper", "UPPER", "Mixed", "dir.with.dots", "empty" }) {
+        makeDirectory(site + path);
+    }
+    for (const char* path : { "index.html", "page.html", "page.php", "other.php", "Mixed.html", "MixedCase.html",
+                              "docs/index.html", "docs.html", "sub/file1.html", "sub/file2.htm", "sub/file2.html",
+                              "sub/deep/file3.html", "sub/deep/page.PHP", "upper/index.html", "UPPER/a.html", "noext",
+                              "dir.with.dots/index.html", "twin.txt", "twin.html", "Twin.php" }) {
+        makeFile(site + path);
+    }
+    makeLink("sub", site + "linked");
+    makeLink("page.html", site + "filelink.html");
+    makeLink("docs", site + "doclink");
+    makeLink("nowhere", site + "broken");
+    makeLink("nowhere.html", site + "dangling.html");
+    makeDirectory(directory + "/outside");
+    makeDirectory(directory + "/outside/sub");
+    makeFile(directory + "/outside/page.html");
+    makeFile(directory + "/outside/page.php");
+}
+
+static std::string makeHref(uint64_t& random)
+{
+    static const char* const components[] = {
+        "", ".", "..", "sub", "deep", "docs", "page", "page.php", "page.html", "other.php", "mixed", "Mixed.html",
+        "MIXEDCASE.HTML", "upper", "UPPER", "linked", "filelink.html", "doclink", "broken", "dangling.php",
+        "dir.with.dots", "noext", "file1", "file2.htm", "file3.PHP", "twin.txt", "TWIN.PHP", "empty", "missing",
+        " sub ", "a b", "outside", "site", "index.html",
+    };
+    const size_t count = sizeof(components) / sizeof(components[0]);
+    std::string href;
+    uint64_t r = nextRandom(random);
+    if (r % 8 == 0) href += "/";
+    if (r % 16 == 1) href += "  ";
+    size_t parts = 1 + (r >> 8) % 4;
+    for (size_t p = 0; p < parts; p++) {
+        if (p > 0) href += (nextRandom(random) % 10 == 0) ? "//" : "/";
+        href += components[nextRandom(random) % count];
+    }
+    if ((r >> 16) % 6 == 0) href += "/";
+    if ((r >> 24) % 16 == 0) href += " \t";
+    return href;
+}
+
+int main(int argc, char** argv)
+{
+    std::string directory = "link_resolver_check";
+    size_t cases = 20000;
+    uint64_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (arg == "--dir") {
+            directory = value;
+        } else if (arg == "--cases") {
+            cases = std::strtoul(value.c_str(), nullptr, 10);
+        } else if (arg == "--seed") {
+            seed = std::strtoull(value.c_str(), nullptr, 10);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--dir DIR] [--cases N] [--seed X]" << std::endl;
+            return 1;
+        }
+    }
+
+    size_t failures = 0;
+    try {
+        makeTree(directory);
+        std::string site = directory + "/site/";
+        // Pages in scanned directories, below a symbolic link (not scanned),
+        // with capitals in their directory, and outside the root.
+        const std::vector<std::string> bases = {
+            site + "index.html", site + "sub/file1.html", site + "sub/deep/file3.html", site + "linked/file2.html",
+            site + "UPPER/a.html", site + "Mixed/x.html", site + "dir.with.dots/index.html",
+            directory + "/outside/page.html", directory + "/outside/sub/x.html",
+        };
+
+        uint64_t random = seed;
+        std::vector<std::pair<std::string, std::string> > links;
+        for (size_t c = 0; c < cases; c++) {
+            links.emplace_back(bases[nextRandom(random) % bases.size()], makeHref(random));
+        }
+
+        // A resolver with the tree scanned, twice over the same links (the
+        // second time from its cache), and one that scanned nothing.
+        LinkResolver scanned;
+        scanned.reset(site);
+        LinkResolver unscanned;
+        unscanned.reset("");
+        for (const char* pass : { "resolved", "cached" }) {
+            for (const auto& link : links) {
+                std::string expected = referenceResolve(link.first, link.second);
+                std::string fromScan = scanned.resolve(link.first, link.second);
+                std::string fromStat = unscanned.resolve(link.first, link.second);
+                if ((fromScan != expected || fromStat != expected) && failures++ < 10) {
+                    std::cout << "DIFFERS (" << pass << "): \"" << link.second << "\" on " << link.first << ": "
+                              << fromScan << " / " << fromStat << ", expected " << expected << std::endl;
+                }
+            }
+        }
+        std::cout << "Resolver: " << links.size() << " links checked twice" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return 1;
+    }
+    if (failures > 0) {
+        std::cout << failures << " links differ" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include "mapped_file.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <atomic>
+#include <fstream>
+
+static std::atomic<size_t> liveMappings(0);
+
+// Number of files we allow ourselves to keep mapped at once.
+static size_t mappingBudget()
+{
+    static const size_t budget = []()
+    {
+        size_t limit = 65530; // kernel default
+        std::ifstream proc("/proc/sys/vm/max_map_count");
+        proc >> limit;
+        return limit / 2;
+    }();
+    return budget;
+}
+
+static int64_t nanoseconds(const struct timespec& time)
+{
+    return static_cast<int64_t>(time.tv_sec) * 1000000000 + time.tv_nsec;
+}
+
+MappedFile::MappedFile() : data(nullptr), length(0), mapped(false), modifiedTime(0) {}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data(other.data), length(other.length), mapped(other.mapped), modifiedTime(other.modifiedTime),
+      copy(std::move(other.copy))
+{
+    other.data = nullptr;
+    other.length = 0;
+    other.mapped = false;
+    other.modifiedTime = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other) {
+        close();
+        data = other.data;
+        length = other.length;
+        mapped = other.mapped;
+        modifiedTime = other.modifiedTime;
+        copy = std::move(other.copy);
+        other.data = nullptr;
+        other.length = 0;
+        other.mapped = false;
+        other.modifiedTime = 0;
+    }
+    return *this;
+}
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    bool known = fstat(fd, &st) == 0;
+    if (known) {
+        modifiedTime = nanoseconds(st.st_mtim);
+    }
+    bool mappable = known && S_ISREG(st.st_mode) && st.st_size > 0;
+    if (mappable && liveMappings.fetch_add(1) < mappingBudget()) {
+        void* address = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address != MAP_FAILED) {
+            data = static_cast<const char*>(address);
+            length = static_cast<size_t>(st.st_size);
+            mapped = true;
+        }
+    }
+    if (mappable && !mapped) {
+        liveMappings--; // the slot reserved above was not used
+    }
+    if (!mapped) {
+        char buffer[65536];
+        ssize_t count;
+        while ((count = ::read(fd, buffer, sizeof(buffer))) > 0) {
+            copy.append(buffer, static_cast<size_t>(count));
+        }
+    }
+    ::close(fd); // the mapping stays valid after the descriptor is closed
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (mapped) {
+        munmap(const_cast<char*>(data), length);
+        liveMappings--;
+    }
+    data = nullptr;
+    length = 0;
+    mapped = false;
+    modifiedTime = 0;
+    copy.clear();
+}
+
+void MappedFile::borrow(std::string_view contents)
+{
+    close();
+    data = contents.data();
+    length = contents.size();
+}
+
+bool fileStatus(const std::string& path, uint64_t& size, int64_t& modified)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+    size = static_cast<uint64_t>(st.st_size);
+    modified = nanoseconds(st.st_mtim);
+    return true;
+}
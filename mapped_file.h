@@ -0,0 +1,50 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Read-only memory mapping of a whole file. The crawler keeps one per
+// document so raw HTML is read in place instead of being copied onto the heap.
+// Each mapping uses one of the process's limited VM areas (vm.max_map_count),
+// which malloc needs too, so only up to half of that limit is spent on
+// documents; past that, or if mmap fails, the file is read into memory.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Map 'path'. Returns false if the file cannot be opened. Files that
+    // open but cannot be mapped (empty files, directories) read as empty.
+    bool open(const std::string& path);
+    void close();
+
+    // Refer to 'contents', which stays mapped elsewhere, instead of a file (a
+    // document carried over from a saved index, see DocumentTable::addCopy).
+    void borrow(std::string_view contents);
+
+    // Modification time of the opened file in nanoseconds since the epoch.
+    int64_t modified() const { return modifiedTime; }
+
+    std::string_view view() const { return data != nullptr ? std::string_view(data, length) : std::string_view(copy); }
+    size_t size() const { return data != nullptr ? length : copy.size(); }
+
+private:
+    const char* data; // mapped or borrowed contents, else null
+    size_t length;
+    bool mapped;      // data is our own mapping
+    int64_t modifiedTime;
+    std::string copy; // contents when the file could not be mapped
+};
+
+// Size and modification time (as MappedFile::modified() gives it) of the file
+// at 'path' without opening it; false if it cannot be stat()ed.
+bool fileStatus(const std::string& path, uint64_t& size, int64_t& modified);
+
+#endif // MAPPED_FILE_H
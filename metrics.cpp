@@ -0,0 +1,180 @@
+#include "metrics.h"
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+const char* metricCounterName(MetricCounter counter)
+{
+    switch (counter) {
+    case COUNTER_FILES_READ: return "crawl_files_read";
+    case COUNTER_BYTES_PARSED: return "crawl_bytes_parsed";
+    case COUNTER_LINKS_NORMALIZED: return "crawl_links_normalized";
+    case COUNTER_LINK_CACHE_HITS: return "crawl_link_cache_hits";
+    case COUNTER_STAT_CALLS: return "crawl_stat_calls";
+    case COUNTER_QUERIES: return "query_ranked";
+    case COUNTER_CANDIDATES: return "query_candidates";
+    case COUNTER_DOCUMENTS_SCORED: return "query_documents_scored";
+    case COUNTER_SNIPPETS: return "query_snippets";
+    default: return "?";
+    }
+}
+
+const char* metricPhaseName(MetricPhase phase)
+{
+    switch (phase) {
+    case PHASE_CRAWL: return "crawl";
+    case PHASE_TOKENIZE: return "tokenize";
+    case PHASE_INDEX: return "index";
+    case PHASE_SCORE: return "score";
+    case PHASE_SNIPPET: return "snippet";
+    case PHASE_OUTPUT: return "output";
+    default: return "?";
+    }
+}
+
+#ifndef NYSEARCH_NO_METRICS
+
+namespace
+{
+
+// Live shards, and the sums of the shards of threads that have exited.
+struct MetricsRegistry
+{
+    std::mutex lock;
+    std::vector<MetricsShard*> shards;
+    MetricsSnapshot retired;
+
+    MetricsRegistry() : retired() {}
+};
+
+MetricsRegistry& registry()
+{
+    // Never destroyed: threads may still exit during static destruction.
+    static MetricsRegistry* instance = new MetricsRegistry();
+    return *instance;
+}
+
+void addShard(MetricsSnapshot& totals, const MetricsShard& shard)
+{
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        totals.counters[i] += shard.counters[i].load(std::memory_order_relaxed);
+    }
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        totals.phaseNanoseconds[i] += shard.phaseNanoseconds[i].load(std::memory_order_relaxed);
+        totals.phaseCalls[i] += shard.phaseCalls[i].load(std::memory_order_relaxed);
+    }
+}
+
+// Owns a thread's shard and retires it when the thread exits.
+class ShardOwner
+{
+public:
+    ShardOwner()
+    {
+        for (std::atomic<uint64_t>& value : shard.counters) value.store(0, std::memory_order_relaxed);
+        for (std::atomic<uint64_t>& value : shard.phaseNanoseconds) value.store(0, std::memory_order_relaxed);
+        for (std::atomic<uint64_t>& value : shard.phaseCalls) value.store(0, std::memory_order_relaxed);
+        MetricsRegistry& metrics = registry();
+        std::lock_guard<std::mutex> guard(metrics.lock);
+        metrics.shards.push_back(&shard);
+    }
+    ~ShardOwner()
+    {
+        MetricsRegistry& metrics = registry();
+        std::lock_guard<std::mutex> guard(metrics.lock);
+        addShard(metrics.retired, shard);
+        for (size_t i = 0; i < metrics.shards.size(); i++) {
+            if (metrics.shards[i] == &shard) {
+                metrics.shards[i] = metrics.shards.back();
+                metrics.shards.pop_back();
+                break;
+            }
+        }
+    }
+
+    MetricsShard shard;
+};
+
+} // namespace
+
+MetricsShard* registerMetricsShard()
+{
+    static thread_local ShardOwner owner;
+    return &owner.shard;
+}
+
+MetricsSnapshot metricsSnapshot()
+{
+    MetricsRegistry& metrics = registry();
+    std::lock_guard<std::mutex> guard(metrics.lock);
+    MetricsSnapshot totals = metrics.retired;
+    for (const MetricsShard* shard : metrics.shards) {
+        addShard(totals, *shard);
+    }
+    return totals;
+}
+
+#else
+
+MetricsSnapshot metricsSnapshot()
+{
+    return MetricsSnapshot();
+}
+
+#endif // NYSEARCH_NO_METRICS
+
+std::string formatMetrics(const MetricsSnapshot& snapshot, MetricsFormat format)
+{
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(6);
+    if (format == METRICS_PROMETHEUS) {
+        for (int i = 0; i < COUNTER_COUNT; i++) {
+            const char* name = metricCounterName(static_cast<MetricCounter>(i));
+            out << "# TYPE nysearch_" << name << "_total counter\n"
+                << "nysearch_" << name << "_total " << snapshot.counters[i] << "\n";
+        }
+        out << "# TYPE nysearch_phase_seconds_total counter\n";
+        for (int i = 0; i < PHASE_COUNT; i++) {
+            out << "nysearch_phase_seconds_total{phase=\"" << metricPhaseName(static_cast<MetricPhase>(i)) << "\"} "
+                << snapshot.phaseNanoseconds[i] / 1e9 << "\n";
+        }
+        out << "# TYPE nysearch_phase_calls_total counter\n";
+        for (int i = 0; i < PHASE_COUNT; i++) {
+            out << "nysearch_phase_calls_total{phase=\"" << metricPhaseName(static_cast<MetricPhase>(i)) << "\"} "
+                << snapshot.phaseCalls[i] << "\n";
+        }
+    } else {
+        out << "{\n  \"counters\": {\n";
+        for (int i = 0; i < COUNTER_COUNT; i++) {
+            out << "    \"" << metricCounterName(static_cast<MetricCounter>(i)) << "\": " << snapshot.counters[i]
+                << (i + 1 < COUNTER_COUNT ? ",\n" : "\n");
+        }
+        out << "  },\n  \"phases\": {\n";
+        for (int i = 0; i < PHASE_COUNT; i++) {
+            out << "    \"" << metricPhaseName(static_cast<MetricPhase>(i)) << "\": {\"seconds\": "
+                << snapshot.phaseNanoseconds[i] / 1e9 << ", \"calls\": " << snapshot.phaseCalls[i] << "}"
+                << (i + 1 < PHASE_COUNT ? ",\n" : "\n");
+        }
+        out << "  }\n}\n";
+    }
+    return out.str();
+}
+
+void writeMetrics(const std::string& path, MetricsFormat format)
+{
+#ifdef NYSEARCH_NO_METRICS
+    (void)format;
+    throw std::runtime_error("cannot write " + path + ": metrics were compiled out (NYSEARCH_NO_METRICS)");
+#else
+    std::string text = formatMetrics(metricsSnapshot(), format);
+    std::ofstream out(path);
+    out << text;
+    out.close();
+    if (!out) {
+        throw std::runtime_error("cannot write metrics to " + path);
+    }
+#endif
+}
@@ -0,0 +1,133 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Process-wide counters and phase timers for the crawl and query paths,
+// exported by --metrics-out. Every thread counts into its own cache-line
+// aligned shard with plain relaxed loads and stores, so the hot paths never
+// contend; a snapshot sums the live shards and those of finished threads.
+// Building with -DNYSEARCH_NO_METRICS turns METRIC_ADD and METRIC_TIME into
+// nothing.
+
+enum MetricCounter
+{
+    COUNTER_FILES_READ,       // crawl: HTML files opened
+    COUNTER_BYTES_PARSED,     // crawl: bytes of those files tokenized
+    COUNTER_LINKS_NORMALIZED, // crawl: local hrefs resolved by normalizePath()
+    COUNTER_LINK_CACHE_HITS,  // crawl: hrefs already resolved for the same directory
+    COUNTER_STAT_CALLS,       // crawl: stat() calls made resolving them
+    COUNTER_QUERIES,          // queries ranked (result cache misses)
+    COUNTER_CANDIDATES,       // documents the index offered those queries
+    COUNTER_DOCUMENTS_SCORED, // candidates that matched and were scored
+    COUNTER_SNIPPETS,         // snippets built for output
+    COUNTER_COUNT
+};
+
+// Phases nest (tokenize and index run inside crawl), and a phase's time is
+// summed over the threads that ran it, so it can exceed the wall time.
+enum MetricPhase
+{
+    PHASE_CRAWL,    // crawl(): fetching, parsing and indexing the site
+    PHASE_TOKENIZE, // parsing one page
+    PHASE_INDEX,    // building the link graph, PageRank and inverted index
+    PHASE_SCORE,    // ranking one query
+    PHASE_SNIPPET,  // building one snippet
+    PHASE_OUTPUT,   // writing one query's output file
+    PHASE_COUNT
+};
+
+enum MetricsFormat
+{
+    METRICS_JSON,
+    METRICS_PROMETHEUS // text exposition format
+};
+
+struct MetricsSnapshot
+{
+    uint64_t counters[COUNTER_COUNT];
+    uint64_t phaseNanoseconds[PHASE_COUNT];
+    uint64_t phaseCalls[PHASE_COUNT];
+};
+
+const char* metricCounterName(MetricCounter counter);
+const char* metricPhaseName(MetricPhase phase);
+
+// Totals so far over every thread (all zero when compiled out).
+MetricsSnapshot metricsSnapshot();
+std::string formatMetrics(const MetricsSnapshot& snapshot, MetricsFormat format);
+// Write metricsSnapshot() to 'path'. Throws std::runtime_error if the file
+// cannot be written or metrics were compiled out.
+void writeMetrics(const std::string& path, MetricsFormat format);
+
+#ifndef NYSEARCH_NO_METRICS
+
+struct alignas(64) MetricsShard
+{
+    std::atomic<uint64_t> counters[COUNTER_COUNT];
+    std::atomic<uint64_t> phaseNanoseconds[PHASE_COUNT];
+    std::atomic<uint64_t> phaseCalls[PHASE_COUNT];
+};
+
+// The calling thread's shard, registered on first use and folded into the
+// totals when the thread exits.
+MetricsShard* registerMetricsShard();
+
+inline MetricsShard& localMetricsShard()
+{
+    static thread_local MetricsShard* shard = nullptr;
+    if (shard == nullptr) {
+        shard = registerMetricsShard();
+    }
+    return *shard;
+}
+
+// Only the owning thread writes a shard, so no read-modify-write is needed.
+inline void addToShard(std::atomic<uint64_t>& value, uint64_t amount)
+{
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+inline void addMetric(MetricCounter counter, uint64_t amount)
+{
+    addToShard(localMetricsShard().counters[counter], amount);
+}
+
+// Adds the time from construction to destruction to a phase.
+class PhaseTimer
+{
+public:
+    explicit PhaseTimer(MetricPhase phase) : phase(phase), start(std::chrono::steady_clock::now()) {}
+    ~PhaseTimer()
+    {
+        uint64_t elapsed = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        MetricsShard& shard = localMetricsShard();
+        addToShard(shard.phaseNanoseconds[phase], elapsed);
+        addToShard(shard.phaseCalls[phase], 1);
+    }
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+private:
+    MetricPhase phase;
+    std::chrono::steady_clock::time_point start;
+};
+
+#define METRIC_CONCAT2(a, b) a##b
+#define METRIC_CONCAT(a, b) METRIC_CONCAT2(a, b)
+#define METRIC_ADD(counter, amount) addMetric((counter), (amount))
+#define METRIC_TIME(phase) PhaseTimer METRIC_CONCAT(phaseTimer, __LINE__)(phase)
+
+#else
+
+// sizeof() keeps the operands referenced without evaluating them.
+#define METRIC_ADD(counter, amount) ((void)sizeof(counter), (void)sizeof(amount))
+#define METRIC_TIME(phase) ((void)sizeof(phase))
+
+#endif // NYSEARCH_NO_METRICS
+
+#endif // METRICS_H
@@ -1,17 +1,39 @@
 #include "search.h"
-#include <dirent.h>  // Include for directory traversal
+#include "query_server.h"
+#include "worker_pool.h"
+#include "text_search.h"
+#include "metrics.h"
+#include "trace.h"
 #include <sys/types.h>
 #include <sys/stat.h>    // for stat()
 #include <dirent.h>      // for opendir(), readdir(), closedir()
 #include <cstring> // Include for string manipulation
+#include <cstdlib>
+#include <cerrno>
+#include <stdexcept>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <vector>
-#include <regex>
 #include <cmath>
-
-Search::Search() : totalDocumentLength(0) {}
+#include <thread>
+#include <limits>
+#include <exception>
+#include <functional>
+#include <memory>
+
+// Default budget of the query result cache.
+static const size_t DEFAULT_RESULT_CACHE_BYTES = 64 << 20;
+
+Search::Search()
+    : indexBuild(0), totalBodyLength(0), totalDocumentLength(0), linkScore(LINK_BACKLINKS), explainPlans(false),
+      resultCache(DEFAULT_RESULT_CACHE_BYTES)
+{
+    lastPageRank.iterations = 0;
+    lastPageRank.residual = 0.0;
+    lastPageRank.seconds = 0.0;
+    lastPageRank.threads = 0;
+}
 
 // ===================================================
 // UTILITY FUNCTIONS
@@ -39,111 +61,59 @@ bool wordExistsAtPosition(const std::string& text, size_t pos, const std::string
 // Returns the position of the first occurrence of 'word' in 'text' (case-insensitive)
 // such that both the character before and after 'word' are NOT alphanumeric (or are
 // the beginning/end of the string). Returns std::string::npos if not found.
-size_t findWord(const std::string& text, const std::string& word, size_t startPos = 0)
+// This folds a copy of 'text'; a document's text is searched through its
+// lowercase shadow with findWholeWord() instead.
+size_t findWord(std::string_view text, const std::string& word, size_t startPos = 0)
 {
-    // Convert both text and word to lowercase for case-insensitive matching
-    std::string lowerText = text;
-    std::string lowerWord = word;
-    std::transform(lowerText.begin(), lowerText.end(), lowerText.begin(), ::tolower);
-    std::transform(lowerWord.begin(), lowerWord.end(), lowerWord.begin(), ::tolower);
-
-    // Search for occurrences of lowerWord in lowerText
-    size_t pos = startPos;
-    while (true) {
-        pos = lowerText.find(lowerWord, pos);
-        if (pos == std::string::npos) {
-            // No more occurrences
-            return std::string::npos;
-        }
-
-        // Check the character before pos
-        bool validBefore = (pos == 0) ||
-            !std::isalnum(static_cast<unsigned char>(lowerText[pos - 1]));
-
-        // Check the character after pos + word.length() - 1
-        size_t afterPos = pos + lowerWord.size();
-        bool validAfter = (afterPos >= lowerText.size()) ||
-            !std::isalnum(static_cast<unsigned char>(lowerText[afterPos]));
-
-        if (validBefore && validAfter) {
-            // Found a standalone occurrence
-            return pos;
-        }
-
-        // Otherwise, continue searching from the next position
-        pos += 1;
-    }
+    return findWholeWord(foldCase(text), foldCase(word), startPos);
 }
 
 // Find a phrase in text with word boundaries
-size_t findPhrase(const std::string& text, const std::string& phrase, size_t startPos = 0)
+size_t findPhrase(std::string_view text, const std::string& phrase, size_t startPos = 0)
 {
-    // Convert both text and phrase to lowercase for case-insensitive matching
-    std::string lowerText = text;
-    std::string lowerPhrase = phrase;
-    std::transform(lowerText.begin(), lowerText.end(), lowerText.begin(), ::tolower);
-    std::transform(lowerPhrase.begin(), lowerPhrase.end(), lowerPhrase.begin(), ::tolower);
-
-    // Search for occurrences of lowerPhrase in lowerText
-    size_t pos = startPos;
-    while (true) {
-        pos = lowerText.find(lowerPhrase, pos);
-        if (pos == std::string::npos) {
-            // No more occurrences
-            return std::string::npos;
-        }
-
-        // Check the character before pos
-        bool validBefore = (pos == 0) ||
-            !std::isalnum(static_cast<unsigned char>(lowerText[pos - 1]));
-
-        // Check the character after pos + phrase.length() - 1
-        size_t afterPos = pos + lowerPhrase.size();
-        bool validAfter = (afterPos >= lowerText.size()) ||
-            !std::isalnum(static_cast<unsigned char>(lowerText[afterPos]));
-
-        if (validBefore && validAfter) {
-            // Found a standalone phrase occurrence
-            return pos;
-        }
+    return findWholeWord(foldCase(text), foldCase(phrase), startPos);
+}
 
-        // Otherwise, continue searching from the next position
-        pos += 1;
-    }
+// Check whether 'lowerPhrase' occurs at 'pos' in 'lowerText' (both already
+// lowercased) with the same word-boundary rules findPhrase uses. This only
+// touches the bytes under the phrase and the two neighbouring characters.
+bool phraseMatchesAt(std::string_view lowerText, size_t pos, const std::string& lowerPhrase)
+{
+    if (pos + lowerPhrase.size() > lowerText.size()) return false;
+    if (lowerText.compare(pos, lowerPhrase.size(), lowerPhrase) != 0) return false;
+    bool validBefore = (pos == 0) ||
+        !isWordByte(static_cast<unsigned char>(lowerText[pos - 1]));
+    size_t afterPos = pos + lowerPhrase.size();
+    bool validAfter = (afterPos >= lowerText.size()) ||
+        !isWordByte(static_cast<unsigned char>(lowerText[afterPos]));
+    return validBefore && validAfter;
 }
 
 // ===================================================
 // WEB CRAWLER COMPONENT
 // ===================================================
 
+// The extractors below all go through the single-pass HtmlTokenizer; the
+// crawler itself parses each page once and uses every field of the result.
 std::list<std::string> Search::extractLinksFromHTML(const std::string& fileContent) 
 {
-    std::list<std::string> links;
-    
-    // Regular expression to match href attributes in anchor tags
-    std::regex linkRegex("<a\\s+[^>]*href\\s*=\\s*['\"]([^'\"]+)['\"][^>]*>");
-    std::smatch match;
-
-    // Search for links in the HTML content
-    std::string::const_iterator start = fileContent.cbegin();
-    while (std::regex_search(start, fileContent.cend(), match, linkRegex)) 
-    {
-        if (match.size() > 1) 
-        {
-            std::string link = match[1].str();
-            links.push_back(link);
-        }
-        start = match.suffix().first;
-    }
-
-    return links;
+    ParsedPage page;
+    tokenizer.parse(fileContent, page);
+    return page.links;
 }
 
 int extractFileNumber(const std::string& url) {
-    std::regex fileNumberRegex("file(\\d+)\\.html");
-    std::smatch match;
-    if (std::regex_search(url, match, fileNumberRegex) && match.size() > 1) {
-        return std::stoi(match[1].str());
+    // Find the first "file<digits>.html" in the URL.
+    size_t pos = url.find("file");
+    while (pos != std::string::npos) {
+        size_t digitsEnd = pos + 4;
+        while (digitsEnd < url.size() && std::isdigit(static_cast<unsigned char>(url[digitsEnd]))) {
+            digitsEnd++;
+        }
+        if (digitsEnd > pos + 4 && url.compare(digitsEnd, 5, ".html") == 0) {
+            return std::stoi(url.substr(pos + 4, digitsEnd - (pos + 4)));
+        }
+        pos = url.find("file", pos + 1);
     }
     return -1; // Return -1 if no file number is found
 }
@@ -151,81 +121,42 @@ int extractFileNumber(const std::string& url) {
 // Function to extract title from HTML content
 std::string Search::extractTitle(const std::string& fileContent) 
 {
-    size_t start = fileContent.find("<title>");
-    size_t end = fileContent.find("</title>");
-    std::smatch match;
-    if (start != std::string::npos && end != std::string::npos) 
-    {
-        return fileContent.substr(start + 7, end - (start + 7));
-    }
-    return "No Title";
+    ParsedPage page;
+    tokenizer.parse(fileContent, page);
+    return page.title;
 }
 
 // Function to extract description from HTML content
 std::string Search::extractDescription(const std::string& fileContent) 
 {
-    std::regex metaRegex("<meta\\s+name=\"description\"\\s+content=\"([^\"]+)\"");
-    std::smatch match;
-    if (std::regex_search(fileContent, match, metaRegex))
-    {
-        return match[1];
-    }
-    return "No Description";
+    ParsedPage page;
+    tokenizer.parse(fileContent, page);
+    return page.description;
 }
 
 
 // Function to extract body content from HTML
 std::string Search::extractBodyContent(const std::string& fileContent) 
 {
-    // Locate the <body> and </body> tags.
-    size_t bodyStart = fileContent.find("<body");
-    if (bodyStart != std::string::npos) {
-        bodyStart = fileContent.find(">", bodyStart);
-        if (bodyStart != std::string::npos) {
-            bodyStart++;  // move past the ">"
-        }
-    }
-    size_t bodyEnd = fileContent.find("</body>");
-    
-    // If both tags are found, use the content in between; otherwise, use the entire file.
-    std::string bodyContent;
-    if (bodyStart != std::string::npos && bodyEnd != std::string::npos) {
-        bodyContent = fileContent.substr(bodyStart, bodyEnd - bodyStart);
-    } else {
-        bodyContent = fileContent;
-    }
-
-    // Manually remove HTML tags while preserving all whitespace and line breaks.
-    std::string result;
-    bool inTag = false;
-    for (char c : bodyContent) {
-        if (c == '<') {
-            inTag = true;
-            continue; // Do not include the tag-start character.
-        } else if (c == '>') {
-            inTag = false;
-            continue; // Do not include the tag-end character.
-        }
-        if (!inTag) {
-            result.push_back(c);  // Append every character as-is.
-        }
-    }
-
-    // Return the result without any further whitespace collapsing.
-    return result;
+    // Text between <body ...> and </body> (or the whole file) with tags removed,
+    // preserving all whitespace and line breaks.
+    ParsedPage page;
+    tokenizer.parse(fileContent, page);
+    return page.body;
 }
 
 std::string Search::createSnippet(
-    const std::unordered_map<std::string, std::string>& documentContents,
-    const std::string& url,
+    DocId doc,
     const std::string& query,
-    bool isPhraseSearch)
+    bool isPhraseSearch) const
 {
+    TraceSpan span("createSnippet", "doc", doc);
     // 1) Use only the already‐extracted <body> text.
-    if (documentContents.find(url) == documentContents.end()) {
+    if (doc >= documents.size()) {
         return "URL not found in document contents.";
     }
-    const std::string& bodyText = documentContents.at(url);
+    std::string bodyText;
+    documents.bodyText(doc, bodyText);
 
     // 2) Determine the target string (handling phrase vs. single/multiple words).
     std::string target;
@@ -242,44 +173,54 @@ std::string Search::createSnippet(
     }
 
     // 3) Find a candidate sentence that contains an exact match to 'target'.
-    //    (Essentially the same logic you have now.)
+    //    A sentence starts after the last '.' at or before the hit (and any
+    //    whitespace following it) and runs through the first '.' at or after
+    //    the hit; both are binary searches in the document's sentence table.
+    std::string_view body(bodyText);
+    const std::vector<uint32_t>& periods = documents.sentenceEnds[doc];
     size_t searchPos = 0;
-    std::string candidateSentence;
+    size_t candidateStart = 0;
+    size_t candidateLength = 0;
     bool foundCandidate = false;
+    size_t rejectedStart = std::string::npos;
+    size_t rejectedEnd = std::string::npos;
 
     while (true) {
-        size_t pos = bodyText.find(target, searchPos);
+        size_t pos = body.find(target, searchPos);
         if (pos == std::string::npos) {
             break;  // No more occurrences
         }
 
-        // Find the beginning of the sentence by looking for the preceding period.
         size_t sentenceStart = 0;
-        if (pos != 0) {
-            sentenceStart = bodyText.rfind('.', pos);
-            if (sentenceStart == std::string::npos) {
-                sentenceStart = 0;
-            } else {
-                sentenceStart++;  // move past the period
-            }
+        std::vector<uint32_t>::const_iterator after = std::upper_bound(periods.begin(), periods.end(), pos);
+        if (pos != 0 && after != periods.begin()) {
+            sentenceStart = *(after - 1) + 1;  // move past the period
         }
 
         // Skip any whitespace right after the period.
-        while (sentenceStart < bodyText.size() &&
-               std::isspace(static_cast<unsigned char>(bodyText[sentenceStart])))
+        while (sentenceStart < body.size() &&
+               std::isspace(static_cast<unsigned char>(body[sentenceStart])))
         {
             sentenceStart++;
         }
 
-        // Find the end of the sentence by looking for the next period.
-        size_t sentenceEnd = bodyText.find('.', pos);
-        if (sentenceEnd == std::string::npos) {
-            sentenceEnd = bodyText.size();
-        } else {
-            sentenceEnd++;  // include the period
+        std::vector<uint32_t>::const_iterator next = std::lower_bound(periods.begin(), periods.end(), pos);
+        size_t sentenceEnd = body.size();
+        if (next != periods.end()) {
+            sentenceEnd = *next + 1;  // include the period
         }
 
-        candidateSentence = bodyText.substr(sentenceStart, sentenceEnd - sentenceStart);
+        // Hits inside a sentence that was already rejected give the same answer.
+        if (sentenceStart == rejectedStart && sentenceEnd == rejectedEnd) {
+            searchPos = pos + 1;
+            continue;
+        }
+        rejectedStart = sentenceStart;
+        rejectedEnd = sentenceEnd;
+
+        // (If the whitespace skip ran past the period, the sentence is the
+        // rest of the body, as substr() with a wrapped length always gave.)
+        std::string_view candidateSentence = body.substr(sentenceStart, sentenceEnd - sentenceStart);
 
         // Reject candidate if it appears to be a file URL (starts with "html_files/").
         if (candidateSentence.rfind("html_files/", 0) == 0) {
@@ -305,60 +246,35 @@ std::string Search::createSnippet(
 
         if (exactMatchFound) {
             foundCandidate = true;
+            candidateStart = sentenceStart;
+            candidateLength = candidateSentence.size();
             break;
         }
         searchPos = pos + 1;
     }
 
-    // 4) If no valid candidate sentence was found, fallback to the first 200 chars.
-    std::string snippet;
-    if (!foundCandidate) {
-        snippet = bodyText.substr(0, std::min<size_t>(200, bodyText.size()));
-    } else {
-        snippet = candidateSentence;
-    }
-
-    // 5) If snippet is longer than 120, truncate.
-    if (snippet.size() > 120) {
-        snippet = snippet.substr(0, 120);
-    }
-    // 6) If snippet is shorter than 120, try to append more characters
-    //    from where that snippet ended in the original body text.
-    else if (snippet.size() < 120) 
-    {
-        // Where does this snippet begin in the body?
-        size_t snippetStartPos = bodyText.find(snippet);
-        if (snippetStartPos != std::string::npos) {
-            // How many extra characters do we need?
-            size_t needed = 120 - snippet.size();
-            // We want to add from bodyText starting at snippetStartPos + snippet.size().
-            size_t nextPos = snippetStartPos + snippet.size();
-            if (nextPos < bodyText.size()) {
-                // Append up to 'needed' characters, or until the end of bodyText.
-                size_t canAppend = std::min(needed, bodyText.size() - nextPos);
-                snippet += bodyText.substr(nextPos, canAppend);
-            }
+    // 4-6) The snippet is a window of up to 120 characters of body text. With
+    //      no candidate sentence it starts at the beginning of the body. A
+    //      sentence of 120 characters or more is cut at 120; a shorter one is
+    //      extended with the text that follows its first appearance in the
+    //      body, which is at or before the candidate itself.
+    size_t windowStart = 0;
+    if (foundCandidate) {
+        windowStart = candidateStart;
+        if (candidateLength < 120) {
+            windowStart = body.substr(0, candidateStart + candidateLength)
+                              .find(body.substr(candidateStart, candidateLength));
         }
     }
+    std::string snippet(body.substr(windowStart, 120));
 
-    // 7) Now we have a snippet that may or may not be exactly 120. 
-    //    If it's still too long, truncate again; if it's still too short, 
-    //    we can’t do much more except pad with spaces (or just leave it).
-    if (snippet.size() > 120) 
+    // 7) Pad a short window (end of body) with spaces up to 120.
+    if (snippet.size() < 120) 
     {
-        snippet = snippet.substr(0, 120);
-    } 
-    else if (snippet.size() < 120) 
-    {
-        // If you want to pad at the very end, do so:
-        while (snippet.size() < 120) 
-        {
-            snippet.push_back(' ');
-        }
+        snippet.append(120 - snippet.size(), ' ');
     }
 
-    // 8) Remove only leading whitespace (not trailing).
-    //    We'll find the first non-whitespace character and slice from there.
+    // 8) Remove only leading whitespace (not trailing), then pad back to 120.
     {
         size_t idx = 0;
         while (idx < snippet.size() && std::isspace(static_cast<unsigned char>(snippet[idx]))) 
@@ -367,16 +283,8 @@ std::string Search::createSnippet(
         }
         if (idx > 0 && idx < snippet.size()) 
         {
-            snippet = snippet.substr(idx);
-        }
-        // If removing leading spaces caused snippet to become shorter than 120,
-        // and you want to preserve exactly 120, you can optionally re-append
-        // some text from the body or pad with spaces again.
-        // For simplicity, let's do a quick re-check:
-        if (snippet.size() < 120) 
-        {
-            size_t needed = 120 - snippet.size();
-            snippet.append(needed, ' ');
+            snippet.erase(0, idx);
+            snippet.append(idx, ' ');
         }
     }
 
@@ -397,98 +305,11 @@ int directoryDepth(const std::string& url)
     return depth;
 }
 
-// Update the normalizePath function to handle absolute paths relative to the seed directory:
+// Resolve an href found on the page at basePath into a crawl path. An href
+// starting with '/' is taken relative to the page's directory like any other
+// (see LinkResolver for the rules and the caching).
 std::string Search::normalizePath(const std::string& basePath, const std::string& relativePath) {
-    // Make a copy of the relative path and trim leading/trailing whitespace.
-    std::string rel = relativePath;
-    while (!rel.empty() && std::isspace(rel.front())) {
-        rel.erase(rel.begin());
-    }
-    while (!rel.empty() && std::isspace(rel.back())) {
-        rel.pop_back();
-    }
-    
-    // Convert to lowercase for case-insensitive file systems.
-    std::transform(rel.begin(), rel.end(), rel.begin(), ::tolower);
-    
-    // If the relative path is actually absolute (starts with '/'),
-    // treat it as relative to the seed directory.
-    if (!rel.empty() && rel[0] == '/') {
-        std::string absPath = seedDirectory + rel;
-        // Now remove the seedDirectory prefix so that rel becomes relative.
-        rel = absPath.substr(seedDirectory.length());
-    }
-    
-    // Extract the base directory from basePath.
-    std::string baseDir = basePath.substr(0, basePath.find_last_of('/') + 1);
-    
-    // Split the (now relative) path into components using '/' as delimiter.
-    std::vector<std::string> components;
-    std::istringstream iss(rel);
-    std::string token;
-    while (std::getline(iss, token, '/')) {
-        // Trim whitespace from each token.
-        token.erase(token.begin(), std::find_if(token.begin(), token.end(), [](int ch) {
-            return !std::isspace(ch);
-        }));
-        token.erase(std::find_if(token.rbegin(), token.rend(), [](int ch) {
-            return !std::isspace(ch);
-        }).base(), token.end());
-        
-        if (token.empty() || token == ".")
-            continue;
-        if (token == "..") {
-            if (!components.empty())
-                components.pop_back();
-        } else {
-            components.push_back(token);
-        }
-    }
-    
-    // Rebuild the final path from the base directory and the components.
-    std::string result = baseDir;
-    for (const std::string &comp : components) {
-        if (result.empty() || result.back() != '/')
-            result += '/';
-        result += comp;
-    }
-    
-    // Collapse any multiple consecutive slashes into one.
-    result = std::regex_replace(result, std::regex("/{2,}"), "/");
-    
-    // If the result ends with a slash, treat it as a directory and append "index.html".
-    if (!result.empty() && result.back() == '/') {
-        result += "index.html";
-    } else {
-        // Otherwise, check if there's an extension.
-        size_t lastDot = result.find_last_of('.');
-        size_t lastSlash = result.find_last_of('/');
-        if (lastDot == std::string::npos || (lastSlash != std::string::npos && lastDot < lastSlash)) {
-            // No extension found. Check if it's a directory.
-            struct stat st;
-            if (stat(result.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
-                if (result.back() != '/')
-                    result += '/';
-                result += "index.html";
-            } else {
-                // Not a directory so assume it's an HTML file.
-                result += ".html";
-            }
-        } else {
-            // If there is an extension but it isn’t ".html", try to use an HTML version if it exists.
-            std::string extension = result.substr(lastDot);
-            std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
-            if (extension != ".html") {
-                std::string htmlVersion = result.substr(0, lastDot) + ".html";
-                struct stat st;
-                if (stat(htmlVersion.c_str(), &st) == 0) {
-                    result = htmlVersion;
-                }
-            }
-        }
-    }
-    
-    return result;
+    return linkResolver.resolve(basePath, relativePath);
 }
 
 // Helper to do a simple case-insensitive ends-with(".html")
@@ -508,130 +329,490 @@ bool Search::endsWithHtml(const std::string& path) {
 
 
 // Main web crawling function - entry point for crawler
-void Search::crawl(const std::string& seedURL) 
+void Search::crawl(const std::string& seedURL, unsigned crawlThreads) 
 {
+    METRIC_TIME(PHASE_CRAWL);
+    TraceSpan span("crawl", "seed", seedURL);
     
     // Clear any previous crawl data
-    crawledURLs.clear();
-    documentTitles.clear();
-    documentDescriptions.clear();
-    documentContents.clear();
-    documentContentLengths.clear();
-    documentOutgoingLinks.clear();
-    incomingLinks.clear();
+    visitedURLs.clear();
+    documents.clear();
     wordCounts.clear();
+    totalBodyLength = 0;
     totalDocumentLength = 0;
+    index.clear();
+    resultCache.invalidate();
+    crawlSeed = seedURL;
+    
+    // Links are resolved against one listing of the seed's directory tree.
+    linkResolver.reset(seedURL.substr(0, seedURL.find_last_of('/') + 1));
     
     // Start crawling from the seed URL
-    crawlURL(seedURL, 0);
+    if (crawlThreads > 1) {
+        crawlParallel(seedURL, crawlThreads);
+    } else {
+        crawlURL(seedURL, 0);
+    }
     
-    // After crawling, build word counts using documentFullContent
-    for (std::set<std::string>::iterator it = crawledURLs.begin(); it != crawledURLs.end(); ++it) 
+    // Build the inverted index and word statistics over everything we reached
+    buildIndex();
+}
+
+// Renumber documents into sorted URL order (the order search results were
+// always produced in), freeze the link graph and compute PageRank over it,
+// and index the word tokens the crawler recorded for each page.
+void Search::buildIndex()
+{
+    METRIC_TIME(PHASE_INDEX);
+    TraceSpan span("buildIndex");
+    documents.finalize();
+    documents.links.setPageRank(computePageRank(documents.links, PageRankOptions(), lastPageRank));
+    for (DocId doc = 0; doc < documents.size(); doc++) 
     {
-        const std::string& url = *it;
-        if (documentFullContent.find(url) != documentFullContent.end()) 
-        {
-            std::string content = documentFullContent[url];
-            std::stringstream ss(content);
-            std::string word;
-            while (ss >> word) {
-                wordCounts[word]++;
-            }
+        index.addDocument(doc, documents.html(doc), documents.terms[doc]);
+        // The tokens are only needed until they are in the index.
+        std::vector<TermSpan>().swap(documents.terms[doc]);
+    }
+    index.freeze();
+}
+
+// Read and parse one file and resolve its links. Touches no shared state
+// apart from the filesystem, so crawl threads can call it concurrently.
+bool Search::fetchPage(const std::string& url, HtmlTokenizer& parser, CrawledPage& crawled)
+{
+    TraceSpan span("fetchPage", "url", url);
+    
+    // Try to open (map) the file
+    if (!openPage(url, crawled)) 
+    {
+        return false;
+    }
+    parsePage(parser, crawled);
+    return true;
+}
+
+// Map a file and record its size, modification time and content hash, which
+// a later updateIndex() compares against.
+bool Search::openPage(const std::string& url, CrawledPage& crawled)
+{
+    if (!crawled.file.open(url)) {
+        return false;
+    }
+    crawled.url = url;
+    METRIC_ADD(COUNTER_FILES_READ, 1);
+    
+    std::string_view content = crawled.file.view();
+    Checksum checksum;
+    checksum.update(content.data(), content.size());
+    crawled.state.modified = crawled.file.modified();
+    crawled.state.size = content.size();
+    crawled.state.hash = checksum.value();
+    return true;
+}
+
+// fetchPage() for recrawl(). A file whose size and modification time, or
+// failing those its contents, still match its document in 'previous' is not
+// parsed again: crawled.unchangedDoc names that document and crawled.links
+// are its saved hrefs resolved again.
+bool Search::refetchPage(const std::string& url, const DocumentTable& previous, HtmlTokenizer& parser,
+                         CrawledPage& crawled)
+{
+    DocId old = previous.find(url);
+    if (old == DocumentTable::NO_DOC) {
+        return fetchPage(url, parser, crawled);
+    }
+    
+    const FileState& known = previous.fileStates[old];
+    uint64_t size;
+    int64_t modified;
+    METRIC_ADD(COUNTER_STAT_CALLS, 1);
+    if (fileStatus(url, size, modified) && size == known.size && modified == known.modified) {
+        crawled.url = url;
+        crawled.state = known;
+    } else if (!openPage(url, crawled)) {
+        return false;
+    } else if (crawled.state.size != known.size || crawled.state.hash != known.hash) {
+        parsePage(parser, crawled);
+        return true;
+    }
+    // A file that was touched but not changed is kept too, with its new state.
+    crawled.file.close();
+    crawled.unchangedDoc = old;
+    for (const std::string& href : previous.hrefs[old]) {
+        crawled.links.push_back(normalizePath(url, href));
+        METRIC_ADD(COUNTER_LINKS_NORMALIZED, 1);
+    }
+    return true;
+}
+
+// Extract document information in one pass over an opened page and resolve
+// its links.
+void Search::parsePage(HtmlTokenizer& parser, CrawledPage& crawled)
+{
+    METRIC_ADD(COUNTER_BYTES_PARSED, crawled.file.size());
+    {
+        METRIC_TIME(PHASE_TOKENIZE);
+        parser.parse(crawled.file.view(), crawled.page);
+    }
+    
+    // Resolve each link
+    crawled.hrefs.clear();
+    crawled.links.clear();
+    for (std::list<std::string>::const_iterator it = crawled.page.links.begin(); it != crawled.page.links.end(); ++it) {
+        const std::string& link = *it;
+        
+        // Skip external links.
+        if (link.find("://") != std::string::npos) {
+            continue;
         }
+        
+        // Normalize the link.
+        crawled.hrefs.push_back(link);
+        crawled.links.push_back(normalizePath(crawled.url, link));
+        METRIC_ADD(COUNTER_LINKS_NORMALIZED, 1);
+    }
+}
+
+// Record a fetched page in the document table. Its links are kept as paths
+// until buildIndex() resolves them into the DocId link graph.
+void Search::storePage(CrawledPage& crawled)
+{
+    ParsedPage& page = crawled.page;
+    DocId doc = documents.add(crawled.url);
+    
+    documents.titles[doc] = page.title;
+    documents.descriptions[doc] = page.description;
+    totalDocumentLength += crawled.file.size();
+    documents.terms[doc].swap(page.terms);
+    
+    // Global keyword density is measured over body text, case-sensitively.
+    totalBodyLength += countAllCharactersInHTML(page.body);
+    for (const TermSpan& span : page.bodyTerms) {
+        wordCounts[page.body.substr(span.offset, span.length)]++;
+    }
+    documents.bodyLength[doc] = static_cast<uint32_t>(page.body.size());
+    
+    // Sentence boundaries for snippets: the offset of every '.' in the body.
+    for (size_t pos = page.body.find('.'); pos != std::string::npos; pos = page.body.find('.', pos + 1)) {
+        documents.sentenceEnds[doc].push_back(static_cast<uint32_t>(pos));
     }
+    documents.bodyRanges[doc].swap(page.bodyRanges);
+    documents.files[doc] = std::move(crawled.file);
+    documents.linkTargets[doc] = crawled.links;
+    documents.fileStates[doc] = crawled.state;
+    documents.hrefs[doc].swap(crawled.hrefs);
+}
+
+// Only links that resolve to .html files are followed.
+static bool isCrawlable(const std::string& path)
+{
+    return path.size() > 5 && path.substr(path.size() - 5) == ".html";
 }
 
 // Recursive crawler function that follows links
 void Search::crawlURL(const std::string& url, int depth) {
-    // Check if we've already crawled this URL
-    if (crawledURLs.find(url) != crawledURLs.end()) {
+    // Check if we've already crawled this URL (and claim it if not)
+    if (!visitedURLs.insert(url)) {
         return;
     }
     
-    // Try to open the file
-    std::ifstream file(url);
-    if (!file.is_open()) 
-    {
+    CrawledPage crawled;
+    if (!fetchPage(url, tokenizer, crawled)) {
         return;
     }
+    storePage(crawled);
     
-    // Mark this URL as crawled
-    crawledURLs.insert(url);
+    // Crawl the linked files that are HTML.
+    for (const std::string& newPath : crawled.links) {
+        if (isCrawlable(newPath)) {
+            crawlURL(newPath, depth + 1);
+        }
+    }
+}
+
+// Multi-threaded crawl. Workers pull URLs from a work-stealing frontier, each
+// with its own tokenizer, and claim newly discovered links through the shared
+// visited set so every file is fetched once. Pages are kept per worker and
+// stored once all workers finish; the maps, link graph and index end up the
+// same as the recursive crawl because none of them depend on visiting order.
+void Search::crawlParallel(const std::string& seedURL, unsigned crawlThreads)
+{
+    CrawlFrontier frontier(crawlThreads);
+    std::vector<std::vector<CrawledPage> > fetched(crawlThreads);
     
-    // Read the file content
-    std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
-    file.close();
+    visitedURLs.insert(seedURL);
+    frontier.push(0, seedURL);
     
-    // Extract and store document information
-    std::string title = extractTitle(content);
-    std::string description = extractDescription(content);
-    std::string bodyContent = extractBodyContent(content);
-    size_t contentLength = content.length();
+    std::vector<std::thread> workers;
+    for (unsigned id = 0; id < crawlThreads; id++) {
+        workers.push_back(std::thread([this, id, &frontier, &fetched]()
+        {
+            HtmlTokenizer parser;
+            std::string url;
+            while (frontier.pop(id, url)) {
+                CrawledPage crawled;
+                if (fetchPage(url, parser, crawled)) {
+                    for (const std::string& newPath : crawled.links) {
+                        if (isCrawlable(newPath) && visitedURLs.insert(newPath)) {
+                            frontier.push(id, newPath);
+                        }
+                    }
+                    fetched[id].push_back(std::move(crawled));
+                }
+                frontier.done();
+            }
+        }));
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
     
-    documentFullContent[url] = content; // Add this line
-    documentTitles[url] = title;
-    documentDescriptions[url] = description;
-    documentContents[url] = bodyContent;
-    documentContentLengths[url] = contentLength;
-    totalDocumentLength += contentLength;
+    for (std::vector<CrawledPage>& pages : fetched) {
+        for (CrawledPage& crawled : pages) {
+            storePage(crawled);
+        }
+    }
+}
+
+// ===================================================
+// PERSISTENT INDEX
+// ===================================================
+
+// Layout of the index directory and its files is described in index_file.h.
+void Search::saveIndex(const std::string& directory)
+{
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw std::runtime_error("cannot create index directory " + directory + ": " + std::strerror(errno));
+    }
+    uint64_t build = documents.fingerprint();
+    documents.save(directory, build);
+    documents.saveCrawlState(directory, crawlSeed, build);
+    index.save(directory, build);
     
-    // Extract links from the document
-    std::list<std::string> links = extractLinksFromHTML(content);
+    // Word counts in sorted order, so the same crawl always writes the same file.
+    std::vector<std::string> words;
+    for (const auto& entry : wordCounts) {
+        words.push_back(entry.first);
+    }
+    std::sort(words.begin(), words.end());
+    std::vector<int32_t> counts;
+    for (const std::string& w : words) {
+        counts.push_back(wordCounts[w]);
+    }
+    std::vector<uint64_t> lengths;
+    lengths.push_back(totalBodyLength);
+    lengths.push_back(totalDocumentLength);
     
-    // Initialize outgoing links set if needed
-    if (documentOutgoingLinks.find(url) == documentOutgoingLinks.end()) {
-        documentOutgoingLinks[url] = std::set<std::string>();
+    IndexFileWriter statsOut(indexFilePath(directory, SECTION_STATS), SECTION_STATS, build);
+    statsOut.writeArray(lengths);
+    statsOut.writeStrings(words);
+    statsOut.writeArray(counts);
+    statsOut.finish();
+}
+
+void Search::loadIndex(const std::string& directory)
+{
+    visitedURLs.clear();
+    resultCache.invalidate();
+    crawlSeed.clear();
+    indexBuild = documents.load(directory);
+    index.load(directory, documents.size(), indexBuild);
+    
+    MappedFile statsFile;
+    IndexFileReader statsIn(statsFile, indexFilePath(directory, SECTION_STATS), SECTION_STATS);
+    statsIn.expectBuild(indexBuild);
+    std::vector<uint64_t> lengths;
+    std::vector<std::string> words;
+    std::vector<int32_t> counts;
+    statsIn.readArray(lengths);
+    statsIn.readStrings(words);
+    statsIn.readArray(counts);
+    statsIn.finish();
+    if (lengths.size() != 2 || counts.size() != words.size()) {
+        statsIn.fail("malformed statistics");
+    }
+    totalBodyLength = static_cast<size_t>(lengths[0]);
+    totalDocumentLength = static_cast<size_t>(lengths[1]);
+    wordCounts.clear();
+    wordCounts.reserve(words.size());
+    for (size_t i = 0; i < words.size(); i++) {
+        wordCounts[words[i]] = counts[i];
+    }
+}
+
+// ===================================================
+// INCREMENTAL RECRAWL
+// ===================================================
+
+RecrawlStats Search::updateIndex(const std::string& seedURL, const std::string& directory, unsigned crawlThreads)
+{
+    RecrawlStats stats = RecrawlStats();
+    std::string seed;
+    try {
+        loadIndex(directory);
+        stats.incremental = documents.loadCrawlState(directory, seed, indexBuild) && seed == seedURL;
+    } catch (const std::runtime_error&) {
+        // No index yet, or one this build cannot read: start over.
+        stats.incremental = false;
+    }
+    if (!stats.incremental) {
+        crawl(seedURL, crawlThreads);
+        stats.added = documents.size();
+        return stats;
     }
+    recrawl(seedURL, crawlThreads, stats);
+    return stats;
+}
+
+// Follow the links from the seed again, starting from the loaded index, on
+// 'crawlThreads' workers like crawlParallel(). A document whose file is
+// unchanged is carried over from the index with its saved hrefs resolved
+// again (a new or removed file can change where they lead); only changed and
+// new files are parsed. Files that are no longer reached drop out.
+void Search::recrawl(const std::string& seedURL, unsigned crawlThreads, RecrawlStats& stats)
+{
+    METRIC_TIME(PHASE_CRAWL);
+    TraceSpan span("recrawl", "seed", seedURL);
     
-    // Process each link
-    for (std::list<std::string>::iterator it = links.begin(); it != links.end(); ++it) {
-        std::string link = *it;
-        
-        // Skip external links.
-        if (link.find("://") != std::string::npos) {
-            continue;
+    DocumentTable previous = std::move(documents);
+    documents.clear();
+    visitedURLs.clear();
+    resultCache.invalidate();
+    crawlSeed = seedURL;
+    linkResolver.reset(seedURL.substr(0, seedURL.find_last_of('/') + 1));
+    
+    crawlThreads = std::max(1u, crawlThreads);
+    CrawlFrontier frontier(crawlThreads);
+    std::vector<std::vector<CrawledPage> > revisited(crawlThreads);
+    visitedURLs.insert(seedURL);
+    frontier.push(0, seedURL);
+    
+    auto work = [this, &previous, &frontier, &revisited](unsigned id)
+    {
+        HtmlTokenizer parser;
+        std::string url;
+        while (frontier.pop(id, url)) {
+            CrawledPage crawled;
+            if (refetchPage(url, previous, parser, crawled)) {
+                for (const std::string& newPath : crawled.links) {
+                    if (isCrawlable(newPath) && visitedURLs.insert(newPath)) {
+                        frontier.push(id, newPath);
+                    }
+                }
+                revisited[id].push_back(std::move(crawled));
+            }
+            frontier.done();
         }
-        
-        // Normalize the link.
-        std::string newPath = normalizePath(url, link);
-        
-        // std::cerr << "DEBUG: Normalizing path." << std::endl
-        //           << "DEBUG: Base Path: " << url << std::endl
-        //           << "DEBUG: Relative Path: " << link << std::endl
-        //           << "DEBUG: Normalized Path: " << newPath << std::endl;
-        
-        // Add to outgoing links only if not linking to self.
-        if (newPath != url) {
-            documentOutgoingLinks[url].insert(newPath);
+    };
+    if (crawlThreads > 1) {
+        std::vector<std::thread> workers;
+        for (unsigned id = 0; id < crawlThreads; id++) {
+            workers.push_back(std::thread(work, id));
         }
-        
-        // Add to incoming links for the target.
-        if (incomingLinks.find(newPath) == incomingLinks.end()) {
-            incomingLinks[newPath] = std::set<std::string>();
+        for (std::thread& worker : workers) {
+            worker.join();
         }
-        incomingLinks[newPath].insert(url);
-        
-        // Crawl the linked file if it's HTML.
-        if (newPath.size() > 5 && newPath.substr(newPath.size() - 5) == ".html") {
-            crawlURL(newPath, depth + 1);
+    } else {
+        work(0);
+    }
+    
+    std::vector<bool> carried(previous.size(), false);
+    std::vector<CrawledPage*> fetched;
+    for (std::vector<CrawledPage>& pages : revisited) {
+        for (CrawledPage& crawled : pages) {
+            if (crawled.unchangedDoc == DocumentTable::NO_DOC) {
+                fetched.push_back(&crawled);
+                if (previous.find(crawled.url) != DocumentTable::NO_DOC) {
+                    stats.changed++;
+                } else {
+                    stats.added++;
+                }
+                continue;
+            }
+            DocId doc = documents.addCopy(previous, crawled.unchangedDoc);
+            documents.fileStates[doc] = crawled.state;
+            documents.linkTargets[doc].swap(crawled.links);
+            carried[crawled.unchangedDoc] = true;
+            stats.unchanged++;
+        }
+    }
+    stats.removed = previous.size() - stats.unchanged - stats.changed;
+    
+    // Take the documents that changed or went away out of the word
+    // statistics; storePage() adds the fetched ones back in.
+    std::string body;
+    for (DocId old = 0; old < previous.size(); old++) {
+        if (carried[old]) {
+            continue;
+        }
+        previous.bodyText(old, body);
+        totalBodyLength -= countAllCharactersInHTML(body);
+        totalDocumentLength -= previous.html(old).size();
+        for (size_t i = 0; i < body.size(); ) {
+            if (!std::isalnum(static_cast<unsigned char>(body[i]))) {
+                i++;
+                continue;
+            }
+            size_t start = i;
+            while (i < body.size() && std::isalnum(static_cast<unsigned char>(body[i]))) {
+                i++;
+            }
+            std::unordered_map<std::string, int>::iterator word = wordCounts.find(body.substr(start, i - start));
+            if (word != wordCounts.end() && --word->second == 0) {
+                wordCounts.erase(word);
+            }
         }
     }
+    for (CrawledPage* crawled : fetched) {
+        storePage(*crawled);
+    }
+    
+    patchIndex(previous, carried);
+    documents.keepContent(previous);
+}
+
+// buildIndex() for a recrawl: the link graph and PageRank are computed again
+// (they are cheap next to the postings, and one changed link can move every
+// PageRank), while the frozen postings are renumbered and merged with the
+// postings of the fetched pages only.
+void Search::patchIndex(const DocumentTable& previous, const std::vector<bool>& carried)
+{
+    METRIC_TIME(PHASE_INDEX);
+    TraceSpan span("patchIndex");
+    documents.finalize();
+    documents.links.setPageRank(computePageRank(documents.links, PageRankOptions(), lastPageRank));
     
-    // After processing links, print the final outgoing links for this file.
-    // std::cerr << "DEBUG: Outgoing links for " << url << ":" << std::endl;
-    // for (const auto& outLink : documentOutgoingLinks[url]) {
-    //     std::cerr << "    " << outLink << std::endl;
-    // }    
+    std::vector<DocId> remap(previous.size(), DocumentTable::NO_DOC);
+    for (DocId old = 0; old < previous.size(); old++) {
+        if (carried[old]) {
+            remap[old] = documents.find(previous.urls[old]);
+        }
+    }
+    std::vector<uint32_t> lengths(documents.size());
+    for (DocId doc = 0; doc < documents.size(); doc++) {
+        lengths[doc] = static_cast<uint32_t>(documents.html(doc).size());
+    }
+    index.beginUpdate(std::move(remap), std::move(lengths));
     
+    // Only fetched pages have tokens; copied documents keep their postings.
+    for (DocId doc = 0; doc < documents.size(); doc++) {
+        if (!documents.terms[doc].empty()) {
+            index.addDocument(doc, documents.html(doc), documents.terms[doc]);
+            std::vector<TermSpan>().swap(documents.terms[doc]);
+        }
+    }
+    index.freeze();
 }
 
 // ===================================================
 // QUERY PROCESSING COMPONENT
 // ===================================================
 
-// Process queries from input file and generate output files
-// Process queries from input file and generate output files
-void Search::processQueries(const std::string& inputFilePath) 
+// Process queries from input file and generate output files. Queries are
+// answered a batch at a time on 'threads' workers, each answer buffered in
+// memory; the batch's output files are then written in query order, so the
+// files and their numbering are the same for any number of threads.
+void Search::processQueries(const std::string& inputFilePath, size_t topK, unsigned threads) 
 {
     std::ifstream inputFile(inputFilePath);
     if (!inputFile.is_open()) 
@@ -639,68 +820,193 @@ void Search::processQueries(const std::string& inputFilePath)
         return;
     }
     
+    std::unique_ptr<WorkerPool> pool;
+    if (threads > 1) {
+        pool.reset(new WorkerPool(threads));
+    }
+    const size_t batchSize = 64 * static_cast<size_t>(std::max(1u, threads));
+    std::vector<std::string> queries;
+    std::vector<std::string> answers;
+    std::vector<std::string> plans;
+    std::vector<std::exception_ptr> failures;
+    
     std::string query;
     int queryIndex = 1;
-    while (std::getline(inputFile, query)) 
+    bool more = true;
+    while (more) 
     {
-        bool isPhraseSearch = query.find('"') != std::string::npos;
-        std::vector<std::pair<std::string, double>> results = search(query, isPhraseSearch);
-        
-        std::ofstream outputFile("out" + std::to_string(queryIndex) + ".txt");
-        if (!outputFile.is_open()) 
-        {
-            continue;
+        queries.clear();
+        while (queries.size() < batchSize && (more = static_cast<bool>(std::getline(inputFile, query)))) {
+            queries.push_back(query);
         }
-        
-        if (results.empty()) {
-            outputFile << "Your search - " << query << " - did not match any documents.\n";
-        } 
-        else 
-        {
-            outputFile << "Matching documents: " << std::endl << std::endl;
-            for (std::vector<std::pair<std::string, double>>::const_iterator it = results.begin(); it != results.end(); ++it) 
+        answers.assign(queries.size(), std::string());
+        plans.assign(queries.size(), std::string());
+        failures.assign(queries.size(), std::exception_ptr());
+        for (size_t i = 0; i < queries.size(); i++) {
+            std::function<void()> answer = [&, i]()
             {
-                const std::string& url = it->first;
-                
-                //double score = it->second;
-                
-                std::string title = documentTitles[url];
-                std::string description = documentDescriptions[url];
-                
-                // Create the snippet using our new snippet function that follows the assignment rules.
-                std::string snippet = createSnippet(documentContents, url, query, isPhraseSearch);
-                // Force the snippet to exactly 120 characters.
-                if (snippet.length() > 120) {
-                    snippet = snippet.substr(0, 120);
-                }
-                
-                outputFile << "Title: " << title << std::endl;
-                outputFile << "URL: " << url << std::endl;
-                //outputFile << "Score: " << score << std::endl; // Debug: print score
-                outputFile << "Description: " << description << std::endl;
-                if(it != results.end() - 1) 
-                {
-                    outputFile << "Snippet: " << snippet << std::endl << std::endl;
-                } 
-                else 
-                {
-                    outputFile << "Snippet: " << snippet << std::endl;
+                try {
+                    if (explainPlans) {
+                        plans[i] = explainQuery(queries[i]);
+                    }
+                    answers[i] = answerQuery(queries[i], topK);
+                } catch (...) {
+                    failures[i] = std::current_exception();
                 }
+            };
+            if (pool) {
+                pool->submit(answer);
+            } else {
+                answer();
             }
         }
+        if (pool) {
+            pool->wait();
+        }
         
-        outputFile.close();
-        queryIndex++;
+        for (size_t i = 0; i < queries.size(); i++) {
+            // A failed query stops the run where the serial loop would have.
+            if (failures[i]) {
+                std::rethrow_exception(failures[i]);
+            }
+            std::cerr << plans[i];
+            METRIC_TIME(PHASE_OUTPUT);
+            std::string outputName = "out" + std::to_string(queryIndex) + ".txt";
+            TraceSpan span("write output", "file", outputName);
+            std::ofstream outputFile(outputName);
+            if (!outputFile.is_open()) 
+            {
+                continue;
+            }
+            outputFile.write(answers[i].data(), answers[i].size());
+            
+            outputFile.close();
+            queryIndex++;
+        }
     }
     
     inputFile.close();
 }
 
+// Run one query line and return the text of its output file.
+std::string Search::answerQuery(const std::string& query, size_t topK) const
+{
+    TraceSpan span("query", "query", query);
+    bool isPhraseSearch = query.find('"') != std::string::npos;
+    return formatResults(query, isPhraseSearch, search(query, isPhraseSearch, topK));
+}
+
+static const char* intersectMethodName(IntersectMethod method)
+{
+    switch (method) {
+    case INTERSECT_DRIVE: return "drive";
+    case INTERSECT_MERGE: return "merge";
+    case INTERSECT_GALLOP: return "gallop";
+    case INTERSECT_BITMAP: return "bitmap";
+    }
+    return "?";
+}
+
+std::string Search::explainQuery(const std::string& query) const
+{
+    std::ostringstream out;
+    out << "Query: " << query << "\n";
+    
+    // The same terms search() looks up.
+    bool isPhraseSearch = query.find('"') != std::string::npos;
+    std::vector<std::string> terms;
+    std::vector<std::string> needsVerification;
+    if (isPhraseSearch) {
+        size_t startQuote = query.find('"');
+        size_t endQuote = query.rfind('"');
+        if (startQuote == endQuote) {
+            out << "  unmatched quote: no results\n";
+            return out.str();
+        }
+        terms = splitTerms(query.substr(startQuote + 1, endQuote - startQuote - 1));
+        out << "  phrase search: intersect, then align positions\n";
+    } else {
+        std::istringstream words(query);
+        std::string keyword;
+        while (words >> keyword) {
+            std::vector<std::string> keywordTerms = splitTerms(keyword);
+            if (keywordTerms.size() != 1 || keywordTerms[0].size() != keyword.size()) {
+                needsVerification.push_back(keyword);
+            }
+            terms.insert(terms.end(), keywordTerms.begin(), keywordTerms.end());
+        }
+        out << "  regular search: intersect\n";
+    }
+    if (terms.empty()) {
+        out << "  no index terms: scan all " << documents.size() << " documents\n";
+        return out.str();
+    }
+    
+    IntersectPlan plan = index.planIntersection(terms);
+    for (const IntersectStep& step : plan.steps) {
+        out << "    " << intersectMethodName(step.method) << " " << step.term << " (" << step.list.size() << " documents)\n";
+    }
+    out << "  candidates: " << index.intersect(plan).size() << " of " << plan.documentCount << " documents\n";
+    for (const std::string& keyword : needsVerification) {
+        out << "  verify in text: " << keyword << "\n";
+    }
+    return out.str();
+}
+
+// Format ranked results the way they are written to an output file.
+std::string Search::formatResults(const std::string& query, bool isPhraseSearch, const std::vector<std::pair<DocId, double> >& results) const
+{
+    std::ostringstream outputFile;
+    if (results.empty()) {
+        outputFile << "Your search - " << query << " - did not match any documents.\n";
+    } 
+    else 
+    {
+        outputFile << "Matching documents: " << "\n\n";
+        for (std::vector<std::pair<DocId, double>>::const_iterator it = results.begin(); it != results.end(); ++it) 
+        {
+            DocId doc = it->first;
+            const std::string& url = documents.urls[doc];
+            
+            //double score = it->second;
+            
+            const std::string& title = documents.titles[doc];
+            const std::string& description = documents.descriptions[doc];
+            
+            // Create the snippet using our new snippet function that follows the assignment rules.
+            std::string snippet;
+            {
+                METRIC_TIME(PHASE_SNIPPET);
+                METRIC_ADD(COUNTER_SNIPPETS, 1);
+                snippet = createSnippet(doc, query, isPhraseSearch);
+            }
+            // Force the snippet to exactly 120 characters.
+            if (snippet.length() > 120) {
+                snippet = snippet.substr(0, 120);
+            }
+            
+            outputFile << "Title: " << title << "\n";
+            outputFile << "URL: " << url << "\n";
+            //outputFile << "Score: " << score << "\n"; // Debug: print score
+            outputFile << "Description: " << description << "\n";
+            if(it != results.end() - 1) 
+            {
+                outputFile << "Snippet: " << snippet << "\n\n";
+            } 
+            else 
+            {
+                outputFile << "Snippet: " << snippet << "\n";
+            }
+        }
+    }
+    return outputFile.str();
+}
+
 // ===================================================
 // PAGE RANKING COMPONENT
 // ===================================================
 
-size_t Search::countAllCharactersInHTML(const std::string& htmlContent)
+size_t Search::countAllCharactersInHTML(std::string_view htmlContent) const
 {
     // Simply return the total number of characters in the raw HTML string.
     // This counts every character, including whitespace, tags, newlines, etc.
@@ -710,7 +1016,7 @@ size_t Search::countAllCharactersInHTML(const std::string& htmlContent)
 
 // Helper: Count the number of exact occurrences (case sensitive)
 // of 'keyword' in 'text' with valid word boundaries.
-int Search::countExactOccurrences(const std::string& text, const std::string& keyword) 
+int Search::countExactOccurrences(std::string_view text, const std::string& keyword) const 
 {
     if (keyword.empty()) return 0; // avoid infinite loop on empty keyword
     int count = 0;
@@ -736,8 +1042,9 @@ int Search::countExactOccurrences(const std::string& text, const std::string& ke
     return count;
 }
 
-double Search::calculateGlobalKeywordDensity(const std::string& keyword, bool isPhraseSearch) 
+double Search::calculateGlobalKeywordDensity(const std::string& keyword, bool isPhraseSearch) const 
 {
+    TraceSpan span("calculateGlobalKeywordDensity", "keyword", keyword);
     // Split the keyword into words if this is a phrase search.
     std::vector<std::string> words;
     if (isPhraseSearch) {
@@ -751,14 +1058,23 @@ double Search::calculateGlobalKeywordDensity(const std::string& keyword, bool is
     }
     
     double combinedDensity = 0.0;
-    // For each word, iterate over all documents (using raw HTML from documentFullContent)
     for (const std::string& w : words) {
         int totalOccurrences = 0;
-        size_t totalLength = 0;
-        for (std::unordered_map<std::string, std::string>::const_iterator it = documentContents.begin(); it != documentContents.end(); ++it) {
-            const std::string& rawHTML = it->second;
-            totalOccurrences += countExactOccurrences(rawHTML, w);
-            totalLength += countAllCharactersInHTML(rawHTML);
+        size_t totalLength = totalBodyLength;
+        if (isSingleTerm(w)) {
+            // A plain word only ever matches a whole letter/digit run, which
+            // the crawl already counted.
+            std::unordered_map<std::string, int>::const_iterator it = wordCounts.find(w);
+            if (it != wordCounts.end()) {
+                totalOccurrences = it->second;
+            }
+        } else {
+            // Words with punctuation fall back to scanning every body text.
+            std::string body;
+            for (DocId doc = 0; doc < documents.size(); doc++) {
+                documents.bodyText(doc, body);
+                totalOccurrences += countExactOccurrences(body, w);
+            }
         }
         double density = 0.0;
         if (totalLength != 0) {
@@ -769,17 +1085,9 @@ double Search::calculateGlobalKeywordDensity(const std::string& keyword, bool is
     return combinedDensity;
 }
 
-double Search::calculateKeywordDensityScore(const std::string& url, const std::vector<std::string>& keywords, bool isPhraseSearch) {
-    // Use raw HTML for density calculations.
-    if (documentFullContent.find(url) == documentFullContent.end()) {
-        return 0.0;
-    }
-    
-    const std::string& rawHTML = documentFullContent.at(url);
-    size_t docLength = countAllCharactersInHTML(rawHTML);
-    double score = 0.0;
-    
-    // Build a vector of words to score.
+// Build the vector of words a query is scored on.
+std::vector<std::string> Search::densityWords(const std::vector<std::string>& keywords, bool isPhraseSearch) const
+{
     std::vector<std::string> words;
     if (isPhraseSearch && keywords.size() == 1) {
         // Split the single phrase into individual words.
@@ -792,80 +1100,271 @@ double Search::calculateKeywordDensityScore(const std::string& url, const std::v
         // Otherwise, each keyword is used as given.
         words = keywords;
     }
+    return words;
+}
+
+// Corpus-wide density of each word, looked up once per query rather than per
+// document. Words with punctuation are counted together, in one pass over
+// every body text.
+std::vector<double> Search::calculateGlobalDensities(const std::vector<std::string>& words) const
+{
+    TraceSpan span("calculateGlobalDensities");
+    std::vector<double> globalDensities;
+    std::vector<std::string> scanned;
+    std::vector<size_t> scannedIndex;
+    for (size_t i = 0; i < words.size(); i++) {
+        // Here, for each individual word we set isPhraseSearch to false because we already split.
+        if (isSingleTerm(words[i])) {
+            globalDensities.push_back(calculateGlobalKeywordDensity(words[i], false));
+        } else {
+            globalDensities.push_back(0.0);
+            scanned.push_back(words[i]);
+            scannedIndex.push_back(i);
+        }
+    }
+    if (!scanned.empty()) {
+        KeywordMatcher matcher(scanned);
+        KeywordMatches matches;
+        std::vector<int> totalOccurrences(scanned.size(), 0);
+        std::string body;
+        for (DocId doc = 0; doc < documents.size(); doc++) {
+            documents.bodyText(doc, body);
+            matcher.scan(body, matches);
+            for (size_t k = 0; k < scanned.size(); k++) {
+                totalOccurrences[k] += matches.exactCounts[k];
+            }
+        }
+        for (size_t k = 0; k < scanned.size(); k++) {
+            if (totalBodyLength != 0) {
+                globalDensities[scannedIndex[k]] = static_cast<double>(totalOccurrences[k]) / totalBodyLength;
+            }
+        }
+    }
+    return globalDensities;
+}
+
+double Search::calculateKeywordDensityScore(DocId doc, const std::vector<std::string>& keywords, bool isPhraseSearch) const {
+    std::vector<std::string> words = densityWords(keywords, isPhraseSearch);
+    return calculateKeywordDensityScore(doc, words, calculateGlobalDensities(words));
+}
+
+// Density score against corpus densities the caller computed once per query.
+double Search::calculateKeywordDensityScore(DocId doc, const std::vector<std::string>& words, const std::vector<double>& globalDensities) const {
+    if (doc >= documents.size()) {
+        return 0.0;
+    }
+    KeywordMatches matches;
+    KeywordMatcher(words).scan(documents.html(doc), matches);
+    return calculateKeywordDensityScore(doc, matches.exactCounts, globalDensities);
+}
+
+// Density score of occurrence counts the caller found in the document's raw HTML.
+double Search::calculateKeywordDensityScore(DocId doc, const std::vector<int>& occurrences, const std::vector<double>& globalDensities) const {
+    // Use raw HTML for density calculations.
+    if (doc >= documents.size()) {
+        return 0.0;
+    }
+    
+    size_t docLength = countAllCharactersInHTML(documents.html(doc));
+    double score = 0.0;
     
-    for (const std::string& w : words) 
+    for (size_t i = 0; i < globalDensities.size(); i++) 
     {
-        int occurrences = countExactOccurrences(rawHTML, w);
-        double globalDensity = calculateGlobalKeywordDensity(w, false);  
-        // Here, for each individual word we set isPhraseSearch to false because we already split.
+        double globalDensity = globalDensities[i];
         double component = 0.0;
         if (globalDensity > 0 && docLength > 0) {
-            component = static_cast<double>(occurrences) / (docLength * globalDensity);
+            component = static_cast<double>(occurrences[i]) / (docLength * globalDensity);
         }
         score += component;
-        
-        // Debug print for each word component.
-        // std::cerr << "Document: " << url << std::endl
-        //           << "Length: " << docLength << std::endl
-        //           << "Occurrences: " << occurrences << std::endl
-        //           << occurrences << " / (" << docLength << " * " << globalDensity << ") = " 
-        //           << component << std::endl
-        //           << std::endl;
     }
     
     return score;
 }
 
-double Search::calculateBacklinksScore(const std::string& url) 
+double Search::calculateBacklinksScore(DocId doc) const 
 {
-    double score = 0.0;
-    if (incomingLinks.find(url) != incomingLinks.end()) {
-        for (const std::string& backlink : incomingLinks.at(url)) {
-            size_t outgoingLinkCount = 0;
-            if (documentOutgoingLinks.find(backlink) != documentOutgoingLinks.end()) {
-                outgoingLinkCount = documentOutgoingLinks.at(backlink).size();
-            }
-            // Use the actual outgoing link count (do not cap it)
-            score += 1.0 / (1.0 + outgoingLinkCount);
-        }
-    }
-    return score;
+    // Computed for every document when the link graph was frozen.
+    return documents.links.backlinksScore(doc);
 }
 
+double Search::calculatePageRankScore(DocId doc) const
+{
+    return documents.links.pageRank(doc);
+}
 
-double Search::calculateScore(const std::string& url, const std::vector<std::string>& keywords, bool isPhraseSearch) 
+void Search::setLinkScore(LinkScore score)
 {
-    double keywordDensityScore = calculateKeywordDensityScore(url, keywords, isPhraseSearch);
-    double backlinksScore = calculateBacklinksScore(url);
-    double finalScore = 0.5 * keywordDensityScore + 0.5 * backlinksScore;
-    
-    // Build a joined query string for snippet display.
-    std::string joinedQuery;
-    if (isPhraseSearch && keywords.size() == 1) 
-    {
-        joinedQuery = keywords[0];
-    } 
-    else 
-    {
-        for (size_t i = 0; i < keywords.size(); i++) 
-        {
-            if (i > 0) joinedQuery += " ";
-            joinedQuery += keywords[i];
-        }
+    if (score != linkScore) {
+        linkScore = score;
+        resultCache.invalidate(); // cached scores used the other link score
+    }
+}
+
+// The link component selected with setLinkScore().
+double Search::calculateLinkScore(DocId doc) const
+{
+    if (linkScore == LINK_PAGERANK) {
+        return calculatePageRankScore(doc);
     }
-    std::string snippet = createSnippet(documentContents, url, joinedQuery, isPhraseSearch);
+    return calculateBacklinksScore(doc);
+}
+
+
+double Search::calculateScore(DocId doc, const std::vector<std::string>& keywords, bool isPhraseSearch) const 
+{
+    std::vector<double> globalDensities = calculateGlobalDensities(densityWords(keywords, isPhraseSearch));
+    return calculateScore(doc, keywords, isPhraseSearch, globalDensities);
+}
+
+double Search::calculateScore(DocId doc, const std::vector<std::string>& keywords, bool isPhraseSearch, const std::vector<double>& globalDensities) const 
+{
+    double keywordDensityScore = calculateKeywordDensityScore(doc, densityWords(keywords, isPhraseSearch), globalDensities);
+    double linkComponent = calculateLinkScore(doc);
+    double finalScore = 0.5 * keywordDensityScore + 0.5 * linkComponent;
     
     return finalScore;
 }
 
+double Search::calculateScore(DocId doc, const std::vector<int>& occurrences, const std::vector<double>& globalDensities) const
+{
+    double keywordDensityScore = calculateKeywordDensityScore(doc, occurrences, globalDensities);
+    double linkComponent = calculateLinkScore(doc);
+    return 0.5 * keywordDensityScore + 0.5 * linkComponent;
+}
+
 // ===================================================
 // SEARCH FUNCTION
 // ===================================================
 
-// Search for documents matching the query containing ANY of the keywords
-std::vector<std::pair<std::string, double>> Search::search(const std::string& query, bool isPhraseSearch) 
+// Posting lists of the index terms of each density word; a word with no
+// letters or digits gets no lists.
+std::vector<std::vector<PostingList> > Search::densityTermLists(const std::vector<std::string>& words) const
+{
+    std::vector<std::vector<PostingList> > wordLists;
+    for (const std::string& w : words) {
+        std::vector<PostingList> lists;
+        for (const std::string& term : splitTerms(w)) {
+            lists.push_back(index.postings(term));
+        }
+        wordLists.push_back(lists);
+    }
+    return wordLists;
+}
+
+// Cursors over the lists of densityTermLists(), for scoreUpperBound().
+static std::vector<std::vector<PostingIterator> > densityTermCursors(const std::vector<std::vector<PostingList> >& wordLists)
+{
+    std::vector<std::vector<PostingIterator> > wordCursors(wordLists.size());
+    for (size_t i = 0; i < wordLists.size(); i++) {
+        for (const PostingList& list : wordLists[i]) {
+            wordCursors[i].push_back(PostingIterator(list));
+        }
+    }
+    return wordCursors;
+}
+
+// Upper bound on calculateScore() for a document holding every index term of
+// the query. A case-sensitive whole-word match of a density word covers one
+// occurrence of each of its index terms, so the word occurs in the document
+// at most min(tf) times. The bound is computed with the same floating point
+// operations as the real score, only with larger counts, so it can never come
+// out below it. Words with no index terms cannot be bounded. The cursors only
+// move forward, so documents must be bounded in increasing DocId order.
+double Search::scoreUpperBound(DocId doc, std::vector<std::vector<PostingIterator> >& wordCursors, const std::vector<double>& globalDensities) const
+{
+    size_t docLength = countAllCharactersInHTML(documents.html(doc));
+    double score = 0.0;
+    for (size_t i = 0; i < wordCursors.size(); i++) {
+        if (wordCursors[i].empty()) {
+            return std::numeric_limits<double>::infinity();
+        }
+        uint32_t occurrences = std::numeric_limits<uint32_t>::max();
+        for (PostingIterator& cursor : wordCursors[i]) {
+            bool present = cursor.advance(doc) && cursor.doc() == doc;
+            occurrences = std::min(occurrences, present ? cursor.tf() : 0u);
+        }
+        double component = 0.0;
+        if (globalDensities[i] > 0 && docLength > 0) {
+            component = static_cast<double>(occurrences) / (docLength * globalDensities[i]);
+        }
+        score += component;
+    }
+    return 0.5 * score + 0.5 * calculateLinkScore(doc);
+}
+
+// Upper bound on calculateScore() over every document: each word at the
+// highest density any of its index terms reaches in a single document, plus
+// the best link score. The per-term densities were rounded differently
+// from the real score, hence the small safety margin.
+double Search::queryScoreBound(const std::vector<std::vector<PostingList> >& wordLists, const std::vector<double>& globalDensities) const
+{
+    double score = 0.0;
+    for (size_t i = 0; i < wordLists.size(); i++) {
+        if (wordLists[i].empty()) {
+            return std::numeric_limits<double>::infinity();
+        }
+        double density = std::numeric_limits<double>::infinity();
+        for (const PostingList& list : wordLists[i]) {
+            density = std::min(density, list.maxDensity());
+        }
+        if (globalDensities[i] > 0) {
+            score += density / globalDensities[i];
+        }
+    }
+    double maxLinkScore = linkScore == LINK_PAGERANK ? documents.links.maxPageRank()
+                                                     : documents.links.maxBacklinksScore();
+    return (0.5 * score + 0.5 * maxLinkScore) * (1.0 + 1e-9);
+}
+
+// Result cache key of a query: exactly what rankQuery() depends on. A regular
+// query is split on whitespace, so runs of whitespace collapse to one space; a
+// phrase query only reads the text between its outer quotes, which is kept
+// verbatim because the phrase has to match with its own spacing.
+static std::string queryCacheKey(const std::string& query, bool isPhraseSearch, size_t topK)
+{
+    std::string key = (isPhraseSearch ? "P" : "R") + std::to_string(topK) + "|";
+    if (isPhraseSearch) {
+        size_t startQuote = query.find('"');
+        size_t endQuote = query.rfind('"');
+        if (startQuote != std::string::npos && endQuote != std::string::npos && startQuote != endQuote) {
+            key += '"';
+            key.append(query, startQuote + 1, endQuote - startQuote - 1);
+        }
+    } else {
+        std::istringstream words(query);
+        std::string word;
+        while (words >> word) {
+            key += word;
+            key += ' ';
+        }
+    }
+    return key;
+}
+
+// Ranked results of a query, from the result cache when it was seen before.
+std::vector<std::pair<DocId, double>> Search::search(const std::string& query, bool isPhraseSearch, size_t topK) const
+{
+    std::string key = queryCacheKey(query, isPhraseSearch, topK);
+    std::vector<std::pair<DocId, double>> results;
+    if (resultCache.lookup(key, results)) {
+        return results;
+    }
+    results = rankQuery(query, isPhraseSearch, topK);
+    resultCache.insert(key, results);
+    return results;
+}
+
+// Search for documents matching the query containing ANY of the keywords.
+// With topK > 0 only the best topK results are kept; candidates are visited
+// in DocId order, and once the collector is full any candidate whose score
+// upper bound cannot beat the current K-th result is skipped without being
+// verified or scored, and the scan stops as soon as no document could.
+std::vector<std::pair<DocId, double>> Search::rankQuery(const std::string& query, bool isPhraseSearch, size_t topK) const 
 {
-    std::vector<std::pair<std::string, double>> results;
+    METRIC_TIME(PHASE_SCORE);
+    TraceSpan span("rank");
+    TopKResults ranked(topK);
+    size_t scored = 0;
     
     if (isPhraseSearch) {
         // Extract phrase from between quotes
@@ -875,17 +1374,71 @@ std::vector<std::pair<std::string, double>> Search::search(const std::string& qu
         {
             std::string phrase = query.substr(startQuote + 1, endQuote - startQuote - 1);
 
-            // For phrase search, only include documents that contain the exact phrase
-            for (const std::string& url : crawledURLs) {
-                if (documentFullContent.find(url) == documentFullContent.end())
-                    continue;
-                std::string fullContent = documentFullContent[url];
-                if (findPhrase(fullContent, phrase) != std::string::npos) {
-                    // Treat the entire phrase as a single keyword for scoring purposes
-                    std::vector<std::string> phraseAsKeyword;
-                    phraseAsKeyword.push_back(phrase);
-                    double score = calculateScore(url, phraseAsKeyword, isPhraseSearch);
-                    results.push_back({url, score});
+            // Treat the entire phrase as a single keyword for scoring purposes
+            std::vector<std::string> phraseAsKeyword;
+            phraseAsKeyword.push_back(phrase);
+            
+            std::vector<std::string> words = densityWords(phraseAsKeyword, isPhraseSearch);
+            std::vector<double> globalDensities = calculateGlobalDensities(words);
+            
+            // One pass over a matching document counts the density words.
+            KeywordMatcher matcher(words);
+            KeywordMatches found;
+            std::string lowerPhrase = foldCase(phrase);
+            std::vector<std::string> terms = splitTerms(phrase);
+            if (terms.empty()) {
+                // No letters or digits to look up, so search every document's
+                // lowercase shadow as before.
+                METRIC_ADD(COUNTER_CANDIDATES, documents.size());
+                for (DocId doc = 0; doc < documents.size(); doc++) {
+                    if (findWholeWord(documents.lowerHtml(doc), lowerPhrase) != std::string::npos) {
+                        TraceSpan scoreSpan("calculateScore", "doc", doc);
+                        matcher.scan(documents.html(doc), found);
+                        ranked.add(doc, calculateScore(doc, found.exactCounts, globalDensities));
+                        scored++;
+                    }
+                }
+            } else {
+                // The index lines the phrase's terms up by position; the separators
+                // between them (and any leading/trailing punctuation) are then
+                // confirmed against the few bytes around each aligned occurrence.
+                size_t lead = 0;
+                while (!std::isalnum(static_cast<unsigned char>(phrase[lead]))) {
+                    lead++;
+                }
+                
+                std::vector<std::vector<PostingIterator> > wordCursors;
+                double queryBound = std::numeric_limits<double>::infinity();
+                if (topK > 0) {
+                    std::vector<std::vector<PostingList> > wordLists = densityTermLists(words);
+                    queryBound = queryScoreBound(wordLists, globalDensities);
+                    wordCursors = densityTermCursors(wordLists);
+                }
+                
+                std::vector<PhraseMatch> matches;
+                {
+                    TraceSpan candidatesSpan("candidates");
+                    matches = index.matchPhrase(terms);
+                }
+                METRIC_ADD(COUNTER_CANDIDATES, matches.size());
+                for (const PhraseMatch& match : matches) {
+                    if (ranked.full()) {
+                        if (!ranked.admits(queryBound)) break;
+                        if (!ranked.admits(scoreUpperBound(match.doc, wordCursors, globalDensities))) continue;
+                    }
+                    std::string_view lowerContent = documents.lowerHtml(match.doc);
+                    bool aligned = false;
+                    for (size_t i = 0; i < match.offsets.size() && !aligned; i++) {
+                        if (match.offsets[i] >= lead) {
+                            aligned = phraseMatchesAt(lowerContent, match.offsets[i] - lead, lowerPhrase);
+                        }
+                    }
+                    if (aligned) {
+                        TraceSpan scoreSpan("calculateScore", "doc", match.doc);
+                        matcher.scan(documents.html(match.doc), found);
+                        ranked.add(match.doc, calculateScore(match.doc, found.exactCounts, globalDensities));
+                        scored++;
+                    }
                 }
             }
         }
@@ -901,69 +1454,282 @@ std::vector<std::pair<std::string, double>> Search::search(const std::string& qu
             keywords.push_back(word);
         }
         
+        // Every letter/digit run of a keyword must appear as a whole index term
+        // in a matching document. A keyword that is exactly one such run is fully
+        // decided by the index; anything with punctuation is still checked in the text.
+        std::vector<std::string> terms;
+        std::vector<std::string> needsVerification; // lowercased
+        for (const std::string& keyword : keywords) {
+            std::vector<std::string> keywordTerms = splitTerms(keyword);
+            if (keywordTerms.size() != 1 || keywordTerms[0].size() != keyword.size()) {
+                needsVerification.push_back(foldCase(keyword));
+            }
+            terms.insert(terms.end(), keywordTerms.begin(), keywordTerms.end());
+        }
+        
+        std::vector<std::string> words = densityWords(keywords, isPhraseSearch);
+        std::vector<double> globalDensities = calculateGlobalDensities(words);
+        
+        std::vector<DocId> candidates;
+        std::vector<std::vector<PostingIterator> > wordCursors;
+        double queryBound = std::numeric_limits<double>::infinity();
+        if (terms.empty()) {
+            // Nothing to look up (blank query or punctuation only): every document is a candidate.
+            for (DocId doc = 0; doc < documents.size(); doc++) {
+                candidates.push_back(doc);
+            }
+        } else {
+            TraceSpan candidatesSpan("candidates");
+            candidates = index.intersect(terms);
+            if (topK > 0) {
+                std::vector<std::vector<PostingList> > wordLists = densityTermLists(words);
+                queryBound = queryScoreBound(wordLists, globalDensities);
+                wordCursors = densityTermCursors(wordLists);
+            }
+        }
+        
+        METRIC_ADD(COUNTER_CANDIDATES, candidates.size());
+        
+        // One pass over a matching document counts every keyword for the
+        // density score.
+        KeywordMatcher matcher(keywords);
+        KeywordMatches found;
+        
         // Only include documents where ALL keywords (as standalone words) are found.
-        for (const std::string& url : crawledURLs) {
-            if (documentFullContent.find(url) == documentFullContent.end()) continue;
-            std::string fullContent = documentFullContent[url];
+        for (DocId doc : candidates) {
+            if (ranked.full() && !wordCursors.empty()) {
+                if (!ranked.admits(queryBound)) break;
+                if (!ranked.admits(scoreUpperBound(doc, wordCursors, globalDensities))) continue;
+            }
             bool allFound = true;
-            for (const std::string& keyword : keywords) {
-                if (findWord(fullContent, keyword) == std::string::npos) {
-                    allFound = false;
-                    break;
+            if (!needsVerification.empty()) {
+                std::string_view lowerContent = documents.lowerHtml(doc);
+                for (const std::string& lowerKeyword : needsVerification) {
+                    if (findWholeWord(lowerContent, lowerKeyword) == std::string::npos) {
+                        allFound = false;
+                        break;
+                    }
                 }
             }
             if (allFound) {
-                double score = calculateScore(url, keywords, isPhraseSearch);
-                results.push_back({url, score});
+                TraceSpan scoreSpan("calculateScore", "doc", doc);
+                matcher.scan(documents.html(doc), found);
+                ranked.add(doc, calculateScore(doc, found.exactCounts, globalDensities));
+                scored++;
             }
         }
     }
+    METRIC_ADD(COUNTER_QUERIES, 1);
+    METRIC_ADD(COUNTER_DOCUMENTS_SCORED, scored);
     
-    // Sort the results (the comparator code remains unchanged)
-
-    std::sort(results.begin(), results.end(),
-    [](const std::pair<std::string, double>& a,
-       const std::pair<std::string, double>& b) 
-    {
-        return a.second > b.second;
-    });
-
-    
-    return results;
+    // Highest score first, ties in DocId order.
+    return ranked.take();
 }
 
 // ===================================================
 // MAIN FUNCTION
 // ===================================================
+// Programs that link the engine into their own main() (bench.cpp) compile
+// this file with -DNYSEARCH_NO_MAIN.
+#ifndef NYSEARCH_NO_MAIN
 int main(int argc, char** argv) 
 {
-    // Command line format: ./nysearch.exe html_files/index.html input.txt
-    if (argc < 3) {
-        std::cerr << "Usage: " << argv[0] << " <seed_file> <query_file>" << std::endl;
+    // Command line format: ./nysearch.exe html_files/index.html input.txt [options]
+    //                      ./nysearch.exe --index DIR input.txt
+    //   --crawl-threads N   crawl with N threads (default 1: recursive crawl)
+    //   --build-index DIR   save the crawl as an index in DIR (the query file
+    //                       is then optional)
+    //   --update-index DIR  like --build-index, but only re-read the files
+    //                       that changed since DIR was built or updated
+    //   --index DIR         answer queries from a saved index instead of crawling
+    //   --top-k K           write only the K best results of each query
+    //   --explain           print each query's intersection plan on stderr
+    //   --query-threads N   answer the query file on N threads (default:
+    //                       hardware concurrency; the output is the same)
+    //   --link-score S      link component of the score: "backlinks" (default)
+    //                       or "pagerank"
+    //   --cache-mb N        cache ranked results of up to N MB of queries
+    //                       (default 64; 0 disables the cache)
+    //   --cache-stats       report result cache hits and misses on stderr
+    //   --metrics-out FILE  when the program finishes, write crawl and query
+    //                       counters and phase times (see metrics.h) to FILE
+    //   --metrics-format F  "json" (default) or "prometheus"
+    //   --trace FILE        record spans of the crawl and of every query (see
+    //                       trace.h) and write them to FILE as a Chrome trace
+    //   --serve             after crawling or loading, keep answering queries
+    //                       (see query_protocol.h) on stdin/stdout instead of
+    //                       reading a query file
+    //   --socket PATH       with --serve, listen on a Unix domain socket instead
+    //   --serve-threads N   with --serve, answer queries on N threads (default:
+    //                       hardware concurrency)
+    std::vector<std::string> positional;
+    unsigned crawlThreads = 1;
+    std::string buildIndexDir;
+    std::string updateIndexDir;
+    std::string indexDir;
+    size_t topK = 0;
+    LinkScore linkScore = LINK_BACKLINKS;
+    bool serve = false;
+    std::string socketPath;
+    unsigned serveThreads = std::max(1u, std::thread::hardware_concurrency());
+    unsigned queryThreads = serveThreads;
+    long cacheMegabytes = -1;
+    bool cacheStats = false;
+    bool explain = false;
+    std::string metricsPath;
+    MetricsFormat metricsFormat = METRICS_JSON;
+    std::string tracePath;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--crawl-threads" && i + 1 < argc) {
+            crawlThreads = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "--build-index" && i + 1 < argc) {
+            buildIndexDir = argv[++i];
+        } else if (arg == "--update-index" && i + 1 < argc) {
+            updateIndexDir = argv[++i];
+        } else if (arg == "--index" && i + 1 < argc) {
+            indexDir = argv[++i];
+        } else if (arg == "--top-k" && i + 1 < argc) {
+            topK = static_cast<size_t>(std::max(0, std::atoi(argv[++i])));
+        } else if (arg == "--link-score" && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (name == "pagerank") {
+                linkScore = LINK_PAGERANK;
+            } else if (name == "backlinks") {
+                linkScore = LINK_BACKLINKS;
+            } else {
+                std::cerr << "Unknown link score: " << name << " (expected backlinks or pagerank)" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--query-threads" && i + 1 < argc) {
+            queryThreads = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "--cache-mb" && i + 1 < argc) {
+            cacheMegabytes = std::max(0L, std::atol(argv[++i]));
+        } else if (arg == "--metrics-out" && i + 1 < argc) {
+            metricsPath = argv[++i];
+        } else if (arg == "--metrics-format" && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (name == "json") {
+                metricsFormat = METRICS_JSON;
+            } else if (name == "prometheus") {
+                metricsFormat = METRICS_PROMETHEUS;
+            } else {
+                std::cerr << "Unknown metrics format: " << name << " (expected json or prometheus)" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--trace" && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if (arg == "--explain") {
+            explain = true;
+        } else if (arg == "--cache-stats") {
+            cacheStats = true;
+        } else if (arg == "--serve") {
+            serve = true;
+        } else if (arg == "--socket" && i + 1 < argc) {
+            socketPath = argv[++i];
+        } else if (arg == "--serve-threads" && i + 1 < argc) {
+            serveThreads = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    size_t required = 2;
+    if (!indexDir.empty() || !buildIndexDir.empty() || !updateIndexDir.empty() || serve) {
+        required = 1;
+    }
+    if (!indexDir.empty() && serve) {
+        required = 0;
+    }
+    if (positional.size() < required) {
+        std::cerr << "Usage: " << argv[0] << " <seed_file> <query_file> [--crawl-threads N] [--build-index DIR] [--top-k K] [--query-threads N] [--link-score S]" << std::endl
+                  << "       " << argv[0] << " <seed_file> (--build-index DIR | --update-index DIR) [--crawl-threads N]" << std::endl
+                  << "       " << argv[0] << " --index DIR <query_file> [--top-k K] [--query-threads N] [--link-score S]" << std::endl
+                  << "       " << argv[0] << " (<seed_file> | --index DIR) --serve [--socket PATH] [--serve-threads N] [--top-k K] [--link-score S]" << std::endl
+                  << "Result cache: [--cache-mb N] [--cache-stats]    Query plans: [--explain]" << std::endl
+                  << "Metrics: [--metrics-out FILE] [--metrics-format json|prometheus]    Tracing: [--trace FILE]" << std::endl;
         return 1;
     }
     
     try {
-        std::string seedFile = argv[1]; // e.g. "html_files/index.html"
-        std::string inputFilePath = argv[2];
-        
-        // Extract the directory from the seed file.
-        size_t pos = seedFile.rfind('/');
-        std::string seedDir;
-        if (pos != std::string::npos) {
-            seedDir = seedFile.substr(0, pos);
-        } else {
-            seedDir = ".";
+        if (!tracePath.empty()) {
+            startTracing();
         }
         
         // Create search engine instance.
         Search searchEngine;
+        searchEngine.setLinkScore(linkScore);
+        searchEngine.setExplain(explain);
+        if (cacheMegabytes >= 0) {
+            searchEngine.setResultCacheSize(static_cast<size_t>(cacheMegabytes) << 20);
+        }
+        std::string inputFilePath;
         
-        // Crawl all .html files in the seed directory.
-        searchEngine.crawl(seedFile);
+        if (!indexDir.empty()) {
+            // Warm start: map a saved index instead of crawling.
+            searchEngine.loadIndex(indexDir);
+            if (!serve) {
+                inputFilePath = positional[0];
+            }
+        } else {
+            std::string seedFile = positional[0]; // e.g. "html_files/index.html"
+            if (positional.size() > 1 && !serve) {
+                inputFilePath = positional[1];
+            }
+            
+            // Crawl all .html files reachable from the seed file, or only
+            // the ones that changed since the index being updated.
+            if (!updateIndexDir.empty()) {
+                RecrawlStats stats = searchEngine.updateIndex(seedFile, updateIndexDir, crawlThreads);
+                if (stats.incremental) {
+                    std::cerr << "Updated " << updateIndexDir << ": " << stats.unchanged << " unchanged, " << stats.changed
+                              << " changed, " << stats.added << " added, " << stats.removed << " removed" << std::endl;
+                } else {
+                    std::cerr << "No index of a crawl from " << seedFile << " in " << updateIndexDir << "; crawled "
+                              << stats.added << " documents" << std::endl;
+                }
+            } else {
+                searchEngine.crawl(seedFile, crawlThreads);
+            }
+            
+            if (linkScore == LINK_PAGERANK) {
+                const PageRankStats& stats = searchEngine.pageRankStats();
+                std::cerr << "PageRank: " << stats.iterations << " iterations, residual " << stats.residual
+                          << ", " << stats.seconds * 1000.0 << " ms on " << stats.threads << " threads" << std::endl;
+            }
+            
+            if (!buildIndexDir.empty()) {
+                searchEngine.saveIndex(buildIndexDir);
+            }
+            if (!updateIndexDir.empty()) {
+                searchEngine.saveIndex(updateIndexDir);
+            }
+        }
         
         // Process search queries.
-        searchEngine.processQueries(inputFilePath);
+        if (serve) {
+            QueryServer server(searchEngine, topK, serveThreads);
+            if (socketPath.empty()) {
+                server.serveStream(std::cin, std::cout);
+            } else {
+                server.serveSocket(socketPath);
+            }
+        } else if (!inputFilePath.empty()) {
+            searchEngine.processQueries(inputFilePath, topK, queryThreads);
+        }
+        
+        if (cacheStats) {
+            ResultCacheStats stats = searchEngine.resultCacheStats();
+            std::cerr << "Result cache: " << stats.hits << " hits, " << stats.misses << " misses, "
+                      << stats.evictions << " evictions, " << stats.invalidations << " invalidations, "
+                      << stats.entries << " entries (" << stats.bytes << " bytes)" << std::endl;
+        }
+        
+        if (!metricsPath.empty()) {
+            writeMetrics(metricsPath, metricsFormat);
+        }
+        if (!tracePath.empty()) {
+            writeTrace(tracePath);
+        }
         
     } catch (const std::bad_alloc& e) {
         std::cerr << "Memory allocation error: " << e.what() << std::endl;
@@ -974,4 +1740,5 @@ int main(int argc, char** argv)
     }
     
     return 0;
-}
\ No newline at end of file
+}
+#endif // NYSEARCH_NO_MAIN
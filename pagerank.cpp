@@ -0,0 +1,112 @@
+#include "pagerank.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+// Documents per block of work; also the granularity of the partial sums.
+static const size_t BLOCK_SIZE = 4096;
+
+PageRankOptions::PageRankOptions()
+    : damping(0.85), tolerance(1e-6), maxIterations(100),
+      threads(std::max(1u, std::thread::hardware_concurrency()))
+{
+}
+
+std::vector<double> computePageRank(const LinkGraph& graph, const PageRankOptions& options, PageRankStats& stats)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    size_t n = graph.size();
+    size_t blocks = (n + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    unsigned threads = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(options.threads, blocks)));
+    stats.iterations = 0;
+    stats.residual = 0.0;
+    stats.threads = threads;
+    if (n == 0) {
+        stats.seconds = 0.0;
+        return std::vector<double>();
+    }
+
+    // share[s] is what each of s's outgoing links carries: rank / out-degree.
+    // Documents without crawled outgoing links are dangling.
+    std::vector<double> inverseDegree(n);
+    for (DocId doc = 0; doc < n; doc++) {
+        size_t degree = graph.outgoing(doc).size();
+        inverseDegree[doc] = degree == 0 ? 0.0 : 1.0 / degree;
+    }
+    std::vector<double> rank(n, 1.0 / n);
+    std::vector<double> share(n);
+    std::vector<double> blockDangling(blocks, 0.0);
+    for (DocId doc = 0; doc < n; doc++) {
+        share[doc] = rank[doc] * inverseDegree[doc];
+        if (inverseDegree[doc] == 0.0) {
+            blockDangling[doc / BLOCK_SIZE] += rank[doc];
+        }
+    }
+
+    std::vector<double> nextRank(n);
+    std::vector<double> nextShare(n);
+    std::vector<double> nextDangling(blocks);
+    std::vector<double> blockResidual(blocks);
+    const double damping = options.damping;
+
+    while (stats.iterations < options.maxIterations) {
+        double dangling = 0.0;
+        for (double mass : blockDangling) {
+            dangling += mass;
+        }
+        const double base = (1.0 - damping) / n + damping * dangling / n;
+
+        // One pass computes the new ranks, the shares the next iteration
+        // pulls, and this block's dangling mass and L1 change.
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; t++) {
+            workers.push_back(std::thread([&, t]()
+            {
+                for (size_t block = t; block < blocks; block += threads) {
+                    size_t first = block * BLOCK_SIZE;
+                    size_t last = std::min(n, first + BLOCK_SIZE);
+                    double danglingMass = 0.0;
+                    double residual = 0.0;
+                    for (size_t doc = first; doc < last; doc++) {
+                        double pulled = 0.0;
+                        for (DocId source : graph.incoming(static_cast<DocId>(doc))) {
+                            // Incoming rows also hold self-links, which are not
+                            // outgoing links.
+                            if (source != doc) {
+                                pulled += share[source];
+                            }
+                        }
+                        double value = base + damping * pulled;
+                        residual += std::fabs(value - rank[doc]);
+                        nextRank[doc] = value;
+                        nextShare[doc] = value * inverseDegree[doc];
+                        if (inverseDegree[doc] == 0.0) {
+                            danglingMass += value;
+                        }
+                    }
+                    nextDangling[block] = danglingMass;
+                    blockResidual[block] = residual;
+                }
+            }));
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+
+        rank.swap(nextRank);
+        share.swap(nextShare);
+        blockDangling.swap(nextDangling);
+        stats.iterations++;
+        stats.residual = 0.0;
+        for (double residual : blockResidual) {
+            stats.residual += residual;
+        }
+        if (stats.residual < options.tolerance) {
+            break;
+        }
+    }
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return rank;
+}
@@ -0,0 +1,34 @@
+#ifndef PAGERANK_H
+#define PAGERANK_H
+
+#include <vector>
+#include "link_graph.h"
+
+struct PageRankOptions
+{
+    PageRankOptions();
+
+    double damping;         // probability of following a link rather than jumping
+    double tolerance;       // stop once the L1 change of an iteration drops below this
+    unsigned maxIterations; // ...or after this many iterations
+    unsigned threads;       // worker threads (default: hardware concurrency)
+};
+
+struct PageRankStats
+{
+    unsigned iterations;
+    double residual; // L1 change of the last iteration
+    double seconds;  // wall time
+    unsigned threads;
+};
+
+// PageRank of every document of 'graph' by power iteration. Each iteration is
+// a sparse matrix-vector product over the incoming-link rows: a document
+// pulls rank / out-degree from every other document linking to it, and the
+// rank of documents with no crawled outgoing links is spread over all
+// documents. Documents are processed in fixed-size blocks spread over the
+// worker threads, and per-block sums are combined in block order, so the
+// result does not depend on the number of threads. The returned ranks sum to 1.
+std::vector<double> computePageRank(const LinkGraph& graph, const PageRankOptions& options, PageRankStats& stats);
+
+#endif // PAGERANK_H
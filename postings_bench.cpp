@@ -0,0 +1,148 @@
+// Postings microbenchmark: loads a saved index (--build-index) and reports the
+// size of the compressed postings and how fast they decode, next to the same
+// values held uncompressed in std::vector<uint32_t>.
+//
+//   ./postings_bench.exe INDEX_DIR [--repeat R]
+
+#include "document_table.h"
+#include "inverted_index.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <index_dir> [--repeat R]" << std::endl;
+        return 1;
+    }
+    unsigned repeat = 5;
+    for (int i = 2; i + 1 < argc; i++) {
+        if (std::string(argv[i]) == "--repeat") {
+            repeat = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+        }
+    }
+
+    try {
+        DocumentTable documents;
+        uint64_t build = documents.load(argv[1]);
+        InvertedIndex index;
+        index.load(argv[1], documents.size(), build);
+        std::vector<PostingList> lists;
+        for (size_t t = 0; t < index.termCount(); t++) {
+            lists.push_back(index.postings(std::string(index.term(t))));
+        }
+        size_t postings = index.postingCount();
+        size_t occurrences = index.occurrenceCount();
+        if (postings == 0) {
+            std::cerr << "Empty index" << std::endl;
+            return 1;
+        }
+
+        // Uncompressed baseline: doc ids, term frequencies, positions and
+        // offsets of every list in plain vectors.
+        std::vector<std::vector<uint32_t> > docs(lists.size());
+        std::vector<std::vector<uint32_t> > frequencies(lists.size());
+        std::vector<std::vector<uint32_t> > positions(lists.size());
+        std::vector<std::vector<uint32_t> > offsets(lists.size());
+        for (size_t t = 0; t < lists.size(); t++) {
+            for (PostingIterator it(lists[t]); !it.atEnd(); it.next()) {
+                docs[t].push_back(it.doc());
+                frequencies[t].push_back(it.tf());
+                positions[t].insert(positions[t].end(), it.positions(), it.positions() + it.tf());
+                offsets[t].insert(offsets[t].end(), it.offsets(), it.offsets() + it.tf());
+            }
+        }
+
+        // Best of 'repeat' runs; the checksums keep the loops from being
+        // optimized away and must agree between the two layouts.
+        double compressedDocs = 1e300, plainDocs = 1e300, compressedAll = 1e300, plainAll = 1e300;
+        uint64_t sumCompressed = 0, sumPlain = 0;
+        for (unsigned r = 0; r < repeat; r++) {
+            Clock::time_point start = Clock::now();
+            uint64_t sum = 0;
+            for (const PostingList& list : lists) {
+                for (PostingIterator it(list); !it.atEnd(); it.next()) {
+                    sum += it.doc();
+                }
+            }
+            compressedDocs = std::min(compressedDocs, secondsSince(start));
+            sumCompressed = sum;
+
+            start = Clock::now();
+            sum = 0;
+            for (const std::vector<uint32_t>& list : docs) {
+                for (uint32_t doc : list) {
+                    sum += doc;
+                }
+            }
+            plainDocs = std::min(plainDocs, secondsSince(start));
+            sumPlain = sum;
+
+            start = Clock::now();
+            sum = 0;
+            for (const PostingList& list : lists) {
+                for (PostingIterator it(list); !it.atEnd(); it.next()) {
+                    uint32_t tf = it.tf();
+                    const uint32_t* p = it.positions();
+                    const uint32_t* o = it.offsets();
+                    sum += it.doc() + tf;
+                    for (uint32_t i = 0; i < tf; i++) {
+                        sum += p[i] + o[i];
+                    }
+                }
+            }
+            compressedAll = std::min(compressedAll, secondsSince(start));
+            sumCompressed += sum;
+
+            start = Clock::now();
+            sum = 0;
+            for (size_t t = 0; t < lists.size(); t++) {
+                size_t occurrence = 0;
+                for (size_t i = 0; i < docs[t].size(); i++) {
+                    uint32_t tf = frequencies[t][i];
+                    sum += docs[t][i] + tf;
+                    for (uint32_t j = 0; j < tf; j++, occurrence++) {
+                        sum += positions[t][occurrence] + offsets[t][occurrence];
+                    }
+                }
+            }
+            plainAll = std::min(plainAll, secondsSince(start));
+            sumPlain += sum;
+        }
+        if (sumCompressed != sumPlain) {
+            std::cerr << "Checksum mismatch" << std::endl;
+            return 1;
+        }
+
+        // The layout before compression: a doc id and a 64-bit occurrence
+        // start per posting, a position and an offset per occurrence.
+        double plainBytes = 4.0 * postings + 8.0 * (postings + 1) + 8.0 * occurrences;
+        std::cout << std::fixed << std::setprecision(2);
+        std::cout << "Terms: " << lists.size() << ", postings: " << postings << ", occurrences: " << occurrences << std::endl;
+        std::cout << "Compressed: " << index.postingBytes() << " bytes, "
+                  << static_cast<double>(index.postingBytes()) / postings << " bytes/posting" << std::endl;
+        std::cout << "Uncompressed: " << static_cast<size_t>(plainBytes) << " bytes, "
+                  << plainBytes / postings << " bytes/posting" << std::endl;
+        std::cout << "Doc ids: " << postings / compressedDocs / 1e6 << " M/s decoded, "
+                  << postings / plainDocs / 1e6 << " M/s from std::vector<uint32_t>" << std::endl;
+        std::cout << "Doc ids + occurrences: " << (postings * 2 + occurrences * 2) / compressedAll / 1e6 << " M values/s decoded, "
+                  << (postings * 2 + occurrences * 2) / plainAll / 1e6 << " M values/s from std::vector<uint32_t>" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
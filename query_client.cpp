@@ -0,0 +1,121 @@
+// Load-testing client for a query server started with --serve --socket.
+// Sends every line of a query file, optionally several times over, through a
+// number of concurrent connections, and reports throughput and latency.
+//
+//   ./nyclient.exe SOCKET QUERY_FILE [--connections N] [--repeat R]
+
+#include "query_protocol.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+// Latency below which 'fraction' of the sorted samples fall (nearest rank).
+static double percentile(const std::vector<double>& sorted, double fraction)
+{
+    if (sorted.empty()) return 0.0;
+    size_t rank = static_cast<size_t>(fraction * sorted.size() + 0.999999);
+    rank = std::min(std::max<size_t>(rank, 1), sorted.size());
+    return sorted[rank - 1];
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> positional;
+    unsigned connections = 1;
+    unsigned repeat = 1;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--connections" && i + 1 < argc) {
+            connections = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            repeat = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.size() < 2) {
+        std::cerr << "Usage: " << argv[0] << " <socket> <query_file> [--connections N] [--repeat R]" << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> queries;
+    std::ifstream input(positional[1]);
+    if (!input.is_open()) {
+        std::cerr << "Cannot open " << positional[1] << std::endl;
+        return 1;
+    }
+    std::string line;
+    while (std::getline(input, line)) {
+        queries.push_back(line);
+    }
+    size_t total = queries.size() * repeat;
+
+    try {
+        // Connect everyone before starting the clock.
+        std::vector<std::unique_ptr<SocketConnection> > sockets;
+        for (unsigned c = 0; c < connections; c++) {
+            sockets.push_back(std::unique_ptr<SocketConnection>(new SocketConnection(connectUnixSocket(positional[0]))));
+        }
+
+        std::atomic<size_t> next(0);
+        std::atomic<size_t> failures(0);
+        std::vector<std::vector<double> > latencies(connections);
+        Clock::time_point start = Clock::now();
+        std::vector<std::thread> workers;
+        for (unsigned c = 0; c < connections; c++) {
+            workers.push_back(std::thread([&, c]()
+            {
+                SocketConnection& socket = *sockets[c];
+                std::string body;
+                for (size_t i = next++; i < total; i = next++) {
+                    Clock::time_point sent = Clock::now();
+                    bool ok = false;
+                    if (!socket.writeAll(queries[i % queries.size()] + "\n") || !socket.readResponse(ok, body)) {
+                        failures++;
+                        break;
+                    }
+                    if (!ok) {
+                        failures++;
+                    }
+                    latencies[c].push_back(std::chrono::duration<double, std::milli>(Clock::now() - sent).count());
+                }
+                // Hang up as soon as this connection's share is done, so the
+                // server can let go of it while the others finish.
+                sockets[c].reset();
+            }));
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        std::vector<double> all;
+        for (const std::vector<double>& samples : latencies) {
+            all.insert(all.end(), samples.begin(), samples.end());
+        }
+        std::sort(all.begin(), all.end());
+
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << "Queries: " << all.size() << " answered, " << failures << " failed, "
+                  << connections << " connections" << std::endl;
+        std::cout << "Wall time: " << seconds << " s" << std::endl;
+        std::cout << "Throughput: " << (seconds > 0 ? all.size() / seconds : 0.0) << " queries/s" << std::endl;
+        std::cout << "Latency: p50 " << percentile(all, 0.50) << " ms, p99 " << percentile(all, 0.99)
+                  << " ms, max " << (all.empty() ? 0.0 : all.back()) << " ms" << std::endl;
+        return failures == 0 ? 0 : 1;
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,161 @@
+#include "query_protocol.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+std::string okResponse(const std::string& body)
+{
+    return "OK " + std::to_string(body.size()) + "\n" + body;
+}
+
+std::string errorResponse(const std::string& message)
+{
+    std::string line = message;
+    std::replace(line.begin(), line.end(), '\n', ' ');
+    return "ERR " + line + "\n";
+}
+
+static sockaddr_un socketAddress(const std::string& path)
+{
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("socket path too long: " + path);
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
+
+int listenUnixSocket(const std::string& path)
+{
+    sockaddr_un address = socketAddress(path);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        throw std::runtime_error("cannot create socket: " + std::string(std::strerror(errno)));
+    }
+    ::unlink(path.c_str());
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(fd, SOMAXCONN) != 0) {
+        int error = errno;
+        ::close(fd);
+        throw std::runtime_error("cannot listen on " + path + ": " + std::strerror(error));
+    }
+    return fd;
+}
+
+int connectUnixSocket(const std::string& path)
+{
+    sockaddr_un address = socketAddress(path);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        throw std::runtime_error("cannot create socket: " + std::string(std::strerror(errno)));
+    }
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        int error = errno;
+        ::close(fd);
+        throw std::runtime_error("cannot connect to " + path + ": " + std::strerror(error));
+    }
+    return fd;
+}
+
+SocketConnection::SocketConnection(int fd) : fd(fd), start(0) {}
+
+SocketConnection::~SocketConnection()
+{
+    ::close(fd);
+}
+
+// Append whatever the socket has to the buffer, dropping consumed bytes first.
+bool SocketConnection::fill()
+{
+    if (start > 0) {
+        buffer.erase(0, start);
+        start = 0;
+    }
+    char chunk[65536];
+    while (true) {
+        ssize_t got = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (got > 0) {
+            buffer.append(chunk, static_cast<size_t>(got));
+            return true;
+        }
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        return false;
+    }
+}
+
+bool SocketConnection::readLine(std::string& line)
+{
+    size_t scanned = 0; // bytes after 'start' known to hold no '\n'
+    while (true) {
+        size_t end = buffer.find('\n', start + scanned);
+        if (end != std::string::npos) {
+            line.assign(buffer, start, end - start);
+            start = end + 1;
+            return true;
+        }
+        scanned = buffer.size() - start;
+        if (!fill()) {
+            return false;
+        }
+    }
+}
+
+bool SocketConnection::readBytes(size_t length, std::string& out)
+{
+    while (buffer.size() - start < length) {
+        if (!fill()) {
+            return false;
+        }
+    }
+    out.assign(buffer, start, length);
+    start += length;
+    return true;
+}
+
+bool SocketConnection::writeAll(std::string_view data)
+{
+    while (!data.empty()) {
+        // MSG_NOSIGNAL: a client that hung up is an error here, not SIGPIPE.
+        ssize_t sent = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data.remove_prefix(static_cast<size_t>(sent));
+    }
+    return true;
+}
+
+bool SocketConnection::readResponse(bool& ok, std::string& body)
+{
+    std::string header;
+    if (!readLine(header)) {
+        return false;
+    }
+    if (header.compare(0, 4, "ERR ") == 0) {
+        ok = false;
+        body = header.substr(4);
+        return true;
+    }
+    if (header.compare(0, 3, "OK ") != 0) {
+        return false;
+    }
+    ok = true;
+    char* end = nullptr;
+    unsigned long long length = std::strtoull(header.c_str() + 3, &end, 10);
+    if (end == header.c_str() + 3 || *end != '\0') {
+        return false;
+    }
+    return readBytes(static_cast<size_t>(length), body);
+}
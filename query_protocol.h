@@ -0,0 +1,53 @@
+#ifndef QUERY_PROTOCOL_H
+#define QUERY_PROTOCOL_H
+
+#include <string>
+#include <string_view>
+
+// Line protocol spoken by --serve, on stdin/stdout or on a Unix domain
+// socket. A request is one query line, exactly as it would appear in a query
+// file. Each request gets one response, in request order:
+//
+//   OK <length>\n<length bytes>   the text the query's output file would hold
+//   ERR <message>\n               the query failed
+//
+// Responses are length-prefixed because result text spans many lines.
+
+std::string okResponse(const std::string& body);
+std::string errorResponse(const std::string& message);
+
+// Unix domain sockets. Both throw std::runtime_error on failure. Listening
+// replaces a stale socket file left at 'path' by a previous server.
+int listenUnixSocket(const std::string& path);
+int connectUnixSocket(const std::string& path);
+
+// Buffered reads and whole writes on a connected socket, which it owns.
+class SocketConnection
+{
+public:
+    explicit SocketConnection(int fd);
+    ~SocketConnection();
+    SocketConnection(const SocketConnection&) = delete;
+    SocketConnection& operator=(const SocketConnection&) = delete;
+
+    int descriptor() const { return fd; }
+
+    // Read up to the next '\n' (not included). False at end of stream.
+    bool readLine(std::string& line);
+    bool readBytes(size_t length, std::string& out);
+    bool writeAll(std::string_view data);
+
+    // Read one response. Returns false if the connection ended or the
+    // response was malformed; 'ok' is false for an ERR response, whose
+    // message is then left in 'body'.
+    bool readResponse(bool& ok, std::string& body);
+
+private:
+    bool fill();
+
+    int fd;
+    std::string buffer;
+    size_t start; // first unread byte of buffer
+};
+
+#endif // QUERY_PROTOCOL_H
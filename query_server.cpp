@@ -0,0 +1,192 @@
+#include "query_server.h"
+#include "query_protocol.h"
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <csignal>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <thread>
+
+// Set by SIGINT/SIGTERM while serveSocket() runs.
+static volatile std::sig_atomic_t stopRequested = 0;
+
+static void requestStop(int)
+{
+    stopRequested = 1;
+}
+
+QueryServer::QueryServer(const Search& engine, size_t topK, unsigned threads)
+    : engine(engine), topK(topK), threads(std::max(1u, threads))
+{
+}
+
+std::string QueryServer::respond(const std::string& query) const
+{
+    try {
+        return okResponse(engine.answerQuery(query, topK));
+    } catch (const std::exception& e) {
+        return errorResponse(e.what());
+    }
+}
+
+// ===================================================
+// STDIN/STDOUT
+// ===================================================
+
+void QueryServer::serveStream(std::istream& in, std::ostream& out)
+{
+    // The reader queues one future per query; the writer waits on them in
+    // order. At most 'limit' answers are in flight so a long input file does
+    // not pile up responses the output cannot take yet.
+    const size_t limit = 4 * static_cast<size_t>(threads);
+    std::mutex lock;
+    std::condition_variable changed;
+    std::deque<std::future<std::string> > pending;
+    bool inputDone = false;
+
+    std::thread writer([&]()
+    {
+        while (true) {
+            std::future<std::string> next;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                changed.wait(guard, [&]() { return inputDone || !pending.empty(); });
+                if (pending.empty()) {
+                    return;
+                }
+                next = std::move(pending.front());
+                pending.pop_front();
+            }
+            changed.notify_all();
+            out << next.get() << std::flush;
+        }
+    });
+
+    {
+        WorkerPool pool(threads);
+        std::string query;
+        while (std::getline(in, query)) {
+            std::shared_ptr<std::promise<std::string> > answer(new std::promise<std::string>());
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                changed.wait(guard, [&]() { return pending.size() < limit; });
+                pending.push_back(answer->get_future());
+            }
+            changed.notify_all();
+            pool.submit([this, answer, query]()
+            {
+                answer->set_value(respond(query));
+            });
+        }
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        inputDone = true;
+    }
+    changed.notify_all();
+    writer.join();
+}
+
+// ===================================================
+// UNIX DOMAIN SOCKET
+// ===================================================
+
+// Read one connection's queries until it closes. Each query is answered on
+// the pool while this thread waits, so the answers go out in request order.
+void QueryServer::serveConnection(int fd, WorkerPool& pool)
+{
+    {
+        SocketConnection connection(fd);
+        std::string query;
+        while (connection.readLine(query)) {
+            std::shared_ptr<std::promise<std::string> > answer(new std::promise<std::string>());
+            std::future<std::string> response = answer->get_future();
+            pool.submit([this, answer, query]()
+            {
+                answer->set_value(respond(query));
+            });
+            if (!connection.writeAll(response.get())) {
+                break;
+            }
+        }
+    }
+    std::lock_guard<std::mutex> guard(connectionsLock);
+    connections.erase(fd);
+    finishedReaders.push_back(std::this_thread::get_id());
+}
+
+// Join the reader threads whose connection has closed, or with 'all' every
+// reader, waiting for them to finish.
+void QueryServer::joinFinishedReaders(bool all)
+{
+    std::vector<std::thread::id> finished;
+    {
+        std::lock_guard<std::mutex> guard(connectionsLock);
+        finished.swap(finishedReaders);
+    }
+    for (std::list<std::thread>::iterator it = readers.begin(); it != readers.end(); ) {
+        if (all || std::find(finished.begin(), finished.end(), it->get_id()) != finished.end()) {
+            it->join();
+            it = readers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void QueryServer::serveSocket(const std::string& path)
+{
+    int listener = listenUnixSocket(path);
+    stopRequested = 0;
+    struct sigaction action;
+    struct sigaction oldInterrupt;
+    struct sigaction oldTerminate;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = requestStop;
+    sigaction(SIGINT, &action, &oldInterrupt);
+    sigaction(SIGTERM, &action, &oldTerminate);
+
+    std::cerr << "Serving on " << path << " with " << threads << " threads" << std::endl;
+    {
+        WorkerPool pool(threads);
+        while (!stopRequested) {
+            joinFinishedReaders(false);
+            // Wake up regularly to notice a stop request.
+            pollfd waiting;
+            waiting.fd = listener;
+            waiting.events = POLLIN;
+            if (::poll(&waiting, 1, 200) <= 0) {
+                continue;
+            }
+            int fd = ::accept(listener, nullptr, nullptr);
+            if (fd < 0) {
+                continue;
+            }
+            {
+                std::lock_guard<std::mutex> guard(connectionsLock);
+                connections.insert(fd);
+            }
+            readers.push_back(std::thread(&QueryServer::serveConnection, this, fd, std::ref(pool)));
+        }
+
+        // Unblock readers waiting on idle clients, and wait for them to
+        // finish before the pool goes away.
+        {
+            std::lock_guard<std::mutex> guard(connectionsLock);
+            for (int fd : connections) {
+                ::shutdown(fd, SHUT_RDWR);
+            }
+        }
+        joinFinishedReaders(true);
+    }
+
+    ::close(listener);
+    ::unlink(path.c_str());
+    sigaction(SIGINT, &oldInterrupt, nullptr);
+    sigaction(SIGTERM, &oldTerminate, nullptr);
+}
@@ -0,0 +1,49 @@
+#ifndef QUERY_SERVER_H
+#define QUERY_SERVER_H
+
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "search.h"
+#include "worker_pool.h"
+
+// Resident query server for --serve: answers queries against a Search that
+// has already crawled or loaded its index, using the line protocol of
+// query_protocol.h. Queries run on a worker pool and only use the const
+// members of Search, so they share the index without locking.
+class QueryServer
+{
+public:
+    QueryServer(const Search& engine, size_t topK, unsigned threads);
+
+    // Answer query lines from 'in' on 'out' until end of input. Queries are
+    // answered concurrently; responses are written in request order.
+    void serveStream(std::istream& in, std::ostream& out);
+
+    // Accept connections on a Unix domain socket at 'path' until SIGINT or
+    // SIGTERM, then remove the socket file. Each connection has a reader
+    // thread of its own that hands its queries to the workers one at a time
+    // and writes the answers in request order, so a client gets concurrency
+    // by opening several connections, and idle connections hold no worker.
+    void serveSocket(const std::string& path);
+
+private:
+    std::string respond(const std::string& query) const;
+    void serveConnection(int fd, WorkerPool& pool);
+    void joinFinishedReaders(bool all);
+
+    const Search& engine;
+    size_t topK;
+    unsigned threads;
+
+    std::mutex connectionsLock;
+    std::set<int> connections; // open sockets, shut down when the server stops
+    std::list<std::thread> readers;                 // one per accepted connection
+    std::vector<std::thread::id> finishedReaders;   // readers whose connection has closed
+};
+
+#endif // QUERY_SERVER_H
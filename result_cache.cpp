@@ -0,0 +1,101 @@
+#include "result_cache.h"
+
+// Rough bookkeeping cost of an entry beyond its key and results: list node,
+// hash node and the shared result vector.
+static const size_t ENTRY_OVERHEAD = 128;
+
+ResultCache::ResultCache(size_t capacityBytes) : capacity(capacityBytes)
+{
+    counters.hits = 0;
+    counters.misses = 0;
+    counters.evictions = 0;
+    counters.invalidations = 0;
+    counters.entries = 0;
+    counters.bytes = 0;
+}
+
+void ResultCache::setCapacity(size_t capacityBytes)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    capacity = capacityBytes;
+    evictUntil(capacity);
+}
+
+bool ResultCache::lookup(const std::string& key, RankedResults& results)
+{
+    std::shared_ptr<const RankedResults> found;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (capacity == 0) {
+            return false;
+        }
+        std::unordered_map<std::string, std::list<Entry>::iterator>::iterator it = byKey.find(key);
+        if (it == byKey.end()) {
+            counters.misses++;
+            return false;
+        }
+        entries.splice(entries.begin(), entries, it->second);
+        found = it->second->results;
+        counters.hits++;
+    }
+    // Copy outside the lock; the entry may be evicted meanwhile, but the
+    // vector lives on until 'found' lets go of it.
+    results = *found;
+    return true;
+}
+
+void ResultCache::insert(const std::string& key, const RankedResults& results)
+{
+    size_t bytes = key.size() + results.size() * sizeof(RankedResults::value_type) + ENTRY_OVERHEAD;
+    std::shared_ptr<const RankedResults> stored(new RankedResults(results));
+
+    std::lock_guard<std::mutex> guard(lock);
+    if (bytes > capacity) {
+        return;
+    }
+    std::unordered_map<std::string, std::list<Entry>::iterator>::iterator it = byKey.find(key);
+    if (it != byKey.end()) {
+        // Another thread answered the same query first.
+        counters.bytes -= it->second->bytes;
+        entries.erase(it->second);
+        byKey.erase(it);
+    }
+    evictUntil(capacity - bytes);
+    Entry entry;
+    entry.key = key;
+    entry.results = stored;
+    entry.bytes = bytes;
+    entries.push_front(entry);
+    byKey[key] = entries.begin();
+    counters.bytes += bytes;
+}
+
+void ResultCache::invalidate()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    entries.clear();
+    byKey.clear();
+    counters.bytes = 0;
+    counters.invalidations++;
+}
+
+ResultCacheStats ResultCache::stats() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    ResultCacheStats snapshot = counters;
+    snapshot.entries = entries.size();
+    return snapshot;
+}
+
+// Evict least recently used entries until at most 'limit' bytes are cached.
+// Caller holds the lock.
+void ResultCache::evictUntil(size_t limit)
+{
+    while (counters.bytes > limit && !entries.empty()) {
+        Entry& victim = entries.back();
+        counters.bytes -= victim.bytes;
+        byKey.erase(victim.key);
+        entries.pop_back();
+        counters.evictions++;
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "inverted_index.h"
+
+typedef std::vector<std::pair<DocId, double> > RankedResults;
+
+struct ResultCacheStats
+{
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;     // entries dropped to make room
+    uint64_t invalidations; // times the whole cache was emptied
+    size_t entries;
+    size_t bytes;
+};
+
+// Size-bounded LRU cache of ranked search results, keyed on a normalized
+// query. Entries are charged for their key and results, so a few full
+// rankings of a common word cannot crowd out everything else unnoticed: the
+// least recently used entries are evicted until the new one fits, and a single
+// entry larger than the whole cache is not stored. Safe to use from any number
+// of threads.
+class ResultCache
+{
+public:
+    explicit ResultCache(size_t capacityBytes);
+
+    // Capacity 0 disables the cache. Shrinking evicts immediately.
+    void setCapacity(size_t capacityBytes);
+
+    // On a hit, copy the cached results into 'results' and return true.
+    bool lookup(const std::string& key, RankedResults& results);
+    void insert(const std::string& key, const RankedResults& results);
+
+    // Drop every entry; counted as one invalidation.
+    void invalidate();
+
+    ResultCacheStats stats() const;
+
+private:
+    struct Entry
+    {
+        std::string key;
+        std::shared_ptr<const RankedResults> results;
+        size_t bytes;
+    };
+    void evictUntil(size_t limit);
+
+    mutable std::mutex lock;
+    std::list<Entry> entries; // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> byKey;
+    size_t capacity;
+    ResultCacheStats counters;
+};
+
+#endif // RESULT_CACHE_H
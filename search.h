@@ -2,12 +2,52 @@
 #define SEARCH_H
 
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <map>
 #include <set>
 #include <list>
 #include <vector>
 #include <algorithm>
+#include "inverted_index.h"
+#include "html_tokenizer.h"
+#include "crawl_frontier.h"
+#include "document_table.h"
+#include "mapped_file.h"
+#include "top_k.h"
+#include "pagerank.h"
+#include "result_cache.h"
+#include "keyword_matcher.h"
+#include "link_resolver.h"
+
+// One page fetched and parsed by the crawler, waiting to be stored.
+struct CrawledPage
+{
+    std::string url;
+    MappedFile file;
+    FileState state;
+    ParsedPage page;
+    std::vector<std::string> hrefs; // local hrefs as written, in document order
+    std::vector<std::string> links; // their normalized targets
+    DocId unchangedDoc = DocumentTable::NO_DOC; // on a recrawl, the saved document the file still matches
+};
+
+// What Search::updateIndex() found, in documents.
+struct RecrawlStats
+{
+    bool incremental; // false if there was no index to update and everything was crawled
+    size_t unchanged;
+    size_t changed;
+    size_t added;
+    size_t removed;
+};
+
+// Link-based component of a document's score.
+enum LinkScore
+{
+    LINK_BACKLINKS, // one hop: sum of 1/(1+out-degree) over incoming links
+    LINK_PAGERANK   // PageRank over the whole link graph
+};
 
 class Search 
 {
@@ -16,7 +56,7 @@ public:
     Search();
     
     // ===== WEB CRAWLER COMPONENT =====
-    void crawl(const std::string& seedURL);
+    void crawl(const std::string& seedURL, unsigned crawlThreads = 1);
     std::list<std::string> extractLinksFromHTML(const std::string& fileContent);
     std::string extractTitle(const std::string& fileContent);
     std::string extractDescription(const std::string& fileContent);
@@ -25,43 +65,115 @@ public:
     bool endsWithHtml(const std::string& path);
     void crawlAllDirectories(const std::string& directoryPath);
     
+    // ===== PERSISTENT INDEX =====
+    // Save everything a crawl produced to an index directory, or replace the
+    // current state with a saved index (no HTML files are read afterwards).
+    void saveIndex(const std::string& directory);
+    void loadIndex(const std::string& directory);
+    
+    // ===== INCREMENTAL RECRAWL =====
+    // Load the index saved in 'directory' and bring it up to date with the
+    // files now reachable from seedURL, ending in the state crawl(seedURL)
+    // would leave (saveIndex() writes it back). Files whose size and
+    // modification time match the ones saved with the index are not read;
+    // others are hashed, and parsed only if their contents changed. Unchanged
+    // documents keep their parsed data and postings, so the work grows with
+    // the number of changed files. Without an index of a crawl from seedURL
+    // in 'directory', this is crawl(seedURL, crawlThreads).
+    RecrawlStats updateIndex(const std::string& seedURL, const std::string& directory, unsigned crawlThreads = 1);
+    
     // ===== QUERY PROCESSING COMPONENT =====
-    void processQueries(const std::string& inputFilePath);
-    std::vector<std::pair<std::string, double> > search(const std::string& query, bool isPhraseSearch);
+    // topK > 0 keeps only the best topK results of each query. Once a crawl or
+    // loadIndex() has finished, the const members only read the index and
+    // document table, so any number of threads may call them concurrently.
+    void processQueries(const std::string& inputFilePath, size_t topK = 0, unsigned threads = 1);
+    std::string answerQuery(const std::string& query, size_t topK = 0) const;
+    
+    // How a query's postings lists are intersected (see
+    // InvertedIndex::planIntersection), as text. With setExplain(true),
+    // processQueries() writes this for every query to stderr.
+    std::string explainQuery(const std::string& query) const;
+    void setExplain(bool enabled) { explainPlans = enabled; }
+    std::string formatResults(const std::string& query, bool isPhraseSearch, const std::vector<std::pair<DocId, double> >& results) const;
+    std::vector<std::pair<DocId, double> > search(const std::string& query, bool isPhraseSearch, size_t topK = 0) const;
+    
+    // Ranked results of search() are cached per normalized query, up to
+    // 'bytes' in total (0 disables the cache). Crawling, loading an index and
+    // changing the link score empty the cache.
+    void setResultCacheSize(size_t bytes) { resultCache.setCapacity(bytes); }
+    ResultCacheStats resultCacheStats() const { return resultCache.stats(); }
     
     // ===== PAGE RANKING COMPONENT =====
-    size_t countAllCharactersInHTML(const std::string& htmlContent);
-    int countExactOccurrences(const std::string& text, const std::string& keyword);
-    double calculateGlobalKeywordDensity(const std::string& keyword, bool isPhraseSearch);
-    double calculateKeywordDensityScore(const std::string& url, const std::vector<std::string>& keywords, bool isPhraseSearch);
-    double calculateBacklinksScore(const std::string& url);
-    double calculateScore(const std::string& url, const std::vector<std::string>& keywords, bool isPhraseSearch);
+    size_t countAllCharactersInHTML(std::string_view htmlContent) const;
+    int countExactOccurrences(std::string_view text, const std::string& keyword) const;
+    double calculateGlobalKeywordDensity(const std::string& keyword, bool isPhraseSearch) const;
+    double calculateKeywordDensityScore(DocId doc, const std::vector<std::string>& keywords, bool isPhraseSearch) const;
+    double calculateKeywordDensityScore(DocId doc, const std::vector<std::string>& words, const std::vector<double>& globalDensities) const;
+    // The same from occurrence counts of the density words, e.g. the first
+    // exactCounts of a KeywordMatcher over densityWords().
+    double calculateKeywordDensityScore(DocId doc, const std::vector<int>& occurrences, const std::vector<double>& globalDensities) const;
+    double calculateBacklinksScore(DocId doc) const;
+    double calculatePageRankScore(DocId doc) const;
+    double calculateLinkScore(DocId doc) const;
+    void setLinkScore(LinkScore score);
     
-    std::string createSnippet(const std::unordered_map<std::string, std::string>& documentContents, const std::string& url, const std::string& query, bool isPhraseSearch);
+    // Iterations and timing of the PageRank computed by the last crawl.
+    const PageRankStats& pageRankStats() const { return lastPageRank; }
+    double calculateScore(DocId doc, const std::vector<std::string>& keywords, bool isPhraseSearch) const;
+    double calculateScore(DocId doc, const std::vector<std::string>& keywords, bool isPhraseSearch, const std::vector<double>& globalDensities) const;
+    double calculateScore(DocId doc, const std::vector<int>& occurrences, const std::vector<double>& globalDensities) const;
+    std::vector<double> calculateGlobalDensities(const std::vector<std::string>& words) const;
+    std::vector<std::string> densityWords(const std::vector<std::string>& keywords, bool isPhraseSearch) const;
     
-private:
-    // New member to track seed directory for absolute path resolution
-    std::string seedDirectory;
+    std::string createSnippet(DocId doc, const std::string& query, bool isPhraseSearch) const;
     
+private:
     // Helper methods
     void crawlURL(const std::string& url, int depth);
+    void crawlParallel(const std::string& seedURL, unsigned crawlThreads);
+    bool fetchPage(const std::string& url, HtmlTokenizer& parser, CrawledPage& crawled);
+    bool openPage(const std::string& url, CrawledPage& crawled);
+    void parsePage(HtmlTokenizer& parser, CrawledPage& crawled);
+    void storePage(CrawledPage& crawled);
+    bool refetchPage(const std::string& url, const DocumentTable& previous, HtmlTokenizer& parser, CrawledPage& crawled);
+    void recrawl(const std::string& seedURL, unsigned crawlThreads, RecrawlStats& stats);
+    void patchIndex(const DocumentTable& previous, const std::vector<bool>& carried);
     std::string normalizePath(const std::string& basePath, const std::string& relativePath);
+    void buildIndex();
     
-    // Document data
-    std::map<std::string, std::string> documentFullContent;
-    std::unordered_map<std::string, std::string> documentTitles; 
-    std::unordered_map<std::string, std::string> documentDescriptions;
-    std::unordered_map<std::string, std::string> documentContents;
-    std::unordered_map<std::string, std::set<std::string>> documentOutgoingLinks;
-    std::unordered_map<std::string, size_t> documentContentLengths;
+    std::vector<std::pair<DocId, double> > rankQuery(const std::string& query, bool isPhraseSearch, size_t topK) const;
     
-    // Link graph data
-    std::unordered_map<std::string, std::set<std::string>> incomingLinks;
-    std::set<std::string> crawledURLs;
+    // Score upper bounds for top-k pruning
+    std::vector<std::vector<PostingList> > densityTermLists(const std::vector<std::string>& words) const;
+    double scoreUpperBound(DocId doc, std::vector<std::vector<PostingIterator> >& wordCursors, const std::vector<double>& globalDensities) const;
+    double queryScoreBound(const std::vector<std::vector<PostingList> >& wordLists, const std::vector<double>& globalDensities) const;
     
-    // Word statistics
+    // Resolves hrefs for the crawl, caching by page directory and href
+    LinkResolver linkResolver;
+    
+    // Document data and link graph, indexed by DocId
+    DocumentTable documents;
+    ConcurrentURLSet visitedURLs;
+    std::string crawlSeed; // seed of the crawl the documents came from, saved with their file states
+    uint64_t indexBuild;   // build id of the index loadIndex() read (see index_file.h)
+    
+    // Inverted index over the raw HTML of every crawled document
+    HtmlTokenizer tokenizer;
+    InvertedIndex index;
+    
+    // Word statistics, computed once per crawl for keyword density scoring:
+    // case-sensitive occurrence counts of every letter/digit run across all
+    // body texts, and the combined length of those body texts.
     std::unordered_map<std::string, int> wordCounts;
+    size_t totalBodyLength;
     size_t totalDocumentLength;
+    
+    LinkScore linkScore;
+    PageRankStats lastPageRank;
+    bool explainPlans;
+    
+    // Internally locked, so const query methods can share it.
+    mutable ResultCache resultCache;
 };
 
 #endif // SEARCH_H
\ No newline at end of file
@@ -0,0 +1,230 @@
+#include "site_generator.h"
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+SiteOptions::SiteOptions()
+    : pages(1000), depth(4), branching(3), fanout(5), vocabulary(20000), zipf(1.0),
+      wordsPerPage(400), seed(1)
+{
+}
+
+// splitmix64: small, fast and the same on every platform.
+class SiteRandom
+{
+public:
+    explicit SiteRandom(uint64_t seed) : state(seed) {}
+
+    uint64_t next()
+    {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+    // Uniform in [0, n).
+    size_t below(size_t n) { return static_cast<size_t>(next() % n); }
+    // Uniform in [0, 1).
+    double unit() { return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0); }
+
+private:
+    uint64_t state;
+};
+
+// Ranks 0..n-1 drawn with probability proportional to 1 / (rank + 1)^exponent.
+class ZipfSampler
+{
+public:
+    ZipfSampler(size_t n, double exponent)
+    {
+        double total = 0.0;
+        for (size_t rank = 0; rank < n; rank++) {
+            total += 1.0 / std::pow(static_cast<double>(rank + 1), exponent);
+            cumulative.push_back(total);
+        }
+    }
+    size_t sample(SiteRandom& random) const
+    {
+        double target = random.unit() * cumulative.back();
+        size_t rank = static_cast<size_t>(std::upper_bound(cumulative.begin(), cumulative.end(), target) - cumulative.begin());
+        return std::min(rank, cumulative.size() - 1);
+    }
+
+private:
+    std::vector<double> cumulative;
+};
+
+// The rank-th made-up word: every one-syllable word, then every two-syllable
+// word, and so on, so frequent words are short like in real text.
+static std::string makeWord(size_t rank)
+{
+    static const char consonants[] = "bdfgklmnprstvz";
+    static const char vowels[] = "aeiou";
+    const size_t syllables = (sizeof(consonants) - 1) * (sizeof(vowels) - 1);
+    size_t length = 1;
+    size_t count = syllables;
+    while (rank >= count) {
+        rank -= count;
+        length++;
+        count *= syllables;
+    }
+    std::string word;
+    for (size_t i = 0; i < length; i++) {
+        size_t syllable = rank % syllables;
+        rank /= syllables;
+        word += consonants[syllable / (sizeof(vowels) - 1)];
+        word += vowels[syllable % (sizeof(vowels) - 1)];
+    }
+    return word;
+}
+
+static void makeDirectory(const std::string& path)
+{
+    if (mkdir(path.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw std::runtime_error("cannot create " + path + ": " + std::strerror(errno));
+    }
+}
+
+// Path from directory 'from' to file 'name' in directory 'to', where both
+// directories are lists of components below the site root.
+static std::string relativeLink(const std::vector<std::string>& from, const std::vector<std::string>& to, const std::string& name)
+{
+    size_t common = 0;
+    while (common < from.size() && common < to.size() && from[common] == to[common]) {
+        common++;
+    }
+    std::string link;
+    for (size_t i = common; i < from.size(); i++) {
+        link += "../";
+    }
+    for (size_t i = common; i < to.size(); i++) {
+        link += to[i] + "/";
+    }
+    return link + name;
+}
+
+GeneratedSite generateSite(const std::string& directory, const SiteOptions& options)
+{
+    SiteRandom random(options.seed);
+    ZipfSampler words(std::max<size_t>(1, options.vocabulary), options.zipf);
+    ZipfSampler targets(std::max<size_t>(1, options.pages), options.zipf);
+
+    GeneratedSite site;
+    site.seedPath = directory + "/index.html";
+    site.pages = options.pages + 1;
+    site.bytes = 0;
+    for (size_t rank = 0; rank < std::max<size_t>(1, options.vocabulary); rank++) {
+        site.vocabulary.push_back(makeWord(rank));
+    }
+
+    // Directories breadth first, numbered subdir1, subdir2, ... across the tree.
+    std::vector<std::vector<std::string> > directories(1);
+    std::vector<std::vector<size_t> > subdirectories(1);
+    for (size_t d = 0; d < directories.size(); d++) {
+        if (directories[d].size() >= options.depth) continue;
+        for (unsigned b = 0; b < options.branching; b++) {
+            subdirectories[d].push_back(directories.size());
+            std::vector<std::string> child = directories[d];
+            child.push_back("subdir" + std::to_string(directories.size()));
+            directories.push_back(child);
+            subdirectories.push_back(std::vector<size_t>());
+        }
+    }
+    makeDirectory(directory);
+    std::vector<std::string> directoryPaths;
+    for (const std::vector<std::string>& components : directories) {
+        std::string path;
+        for (const std::string& component : components) {
+            path += component + "/";
+        }
+        directoryPaths.push_back(path);
+        if (!path.empty()) {
+            makeDirectory(directory + "/" + path);
+        }
+    }
+    std::string siteName = directory.substr(directory.find_last_of('/') + 1);
+
+    // Page p lives in directory p % directories; page 0 is index.html. Page
+    // p links to page p + c - d in each subdirectory c of its directory d, and
+    // pages of the root directory also to the next one there, which spans
+    // the site without "..".
+    const size_t directoryCount = directories.size();
+    size_t phraseBudget = 1000;
+    for (size_t page = 0; page <= options.pages; page++) {
+        size_t dir = page % directoryCount;
+        std::string name = page == 0 ? "index.html" : "file" + std::to_string(page) + ".html";
+
+        std::vector<size_t> links;
+        if (dir == 0 && page + directoryCount <= options.pages) {
+            links.push_back(page + directoryCount);
+        }
+        for (size_t child : subdirectories[dir]) {
+            if (page - dir + child <= options.pages) {
+                links.push_back(page - dir + child);
+            }
+        }
+        while (options.pages > 0 && links.size() < options.fanout) {
+            links.push_back(targets.sample(random) + 1);
+        }
+
+        std::string title;
+        for (size_t i = 0; i < 3; i++) {
+            std::string word = site.vocabulary[words.sample(random)];
+            word[0] = static_cast<char>(word[0] - 'a' + 'A');
+            title += (i > 0 ? " " : "") + word;
+        }
+        std::string description;
+        for (size_t i = 0; i < 8; i++) {
+            description += (i > 0 ? " " : "") + site.vocabulary[words.sample(random)];
+        }
+
+        std::string html = "<!DOCTYPE html>\n<html>\n<head>\n    <title>" + title + "</title>\n"
+                           "    <meta name=\"description\" content=\"" + description + "\">\n"
+                           "</head>\n<body>\n    <h1>" + siteName + "/" + directoryPaths[dir] + name + "</h1>\n";
+        for (size_t target : links) {
+            size_t targetDir = target % directoryCount;
+            std::string targetName = "file" + std::to_string(target) + ".html";
+            html += "    <p><a href=\"" + relativeLink(directories[dir], directories[targetDir], targetName) + "\">" +
+                    targetName + "</a></p>\n";
+        }
+
+        // Sentences of 5 to 15 words, five to a paragraph.
+        size_t bodyWords = options.wordsPerPage / 2 + random.below(options.wordsPerPage + 1);
+        size_t sentence = 0;
+        html += "\n";
+        while (bodyWords > 0) {
+            size_t length = std::min(bodyWords, 5 + random.below(11));
+            bodyWords -= length;
+            std::string previous;
+            for (size_t i = 0; i < length; i++) {
+                std::string word = site.vocabulary[words.sample(random)];
+                if (!previous.empty() && phraseBudget > 0 && random.below(options.wordsPerPage + 1) == 0) {
+                    site.phrases.push_back(previous + " " + word);
+                    phraseBudget--;
+                }
+                previous = word;
+                if (i == 0) {
+                    word[0] = static_cast<char>(word[0] - 'a' + 'A');
+                }
+                html += word;
+                html += i + 1 < length ? " " : ".";
+            }
+            html += ++sentence % 5 == 0 ? "\n\n" : " ";
+        }
+        html += "\n</body>\n</html>\n";
+
+        std::string path = directory + "/" + directoryPaths[dir] + name;
+        std::ofstream out(path, std::ios::binary);
+        out.write(html.data(), static_cast<std::streamsize>(html.size()));
+        if (!out) {
+            throw std::runtime_error("cannot write " + path);
+        }
+        site.bytes += html.size();
+    }
+    return site;
+}
@@ -0,0 +1,46 @@
+#ifndef SITE_GENERATOR_H
+#define SITE_GENERATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct SiteOptions
+{
+    SiteOptions();
+
+    size_t pages;         // fileN.html pages, besides index.html
+    unsigned depth;       // deepest subdirectory nesting below the site root
+    unsigned branching;   // subdirectories per directory, down to 'depth'
+    unsigned fanout;      // links per page (more where a page links down to more subdirectories)
+    size_t vocabulary;    // distinct body words
+    double zipf;          // word (and link target) ranks are Zipf-distributed with this exponent
+    size_t wordsPerPage;  // body words per page, on average
+    uint64_t seed;
+};
+
+struct GeneratedSite
+{
+    std::string seedPath;                // <directory>/index.html
+    size_t pages;                        // index.html included
+    size_t bytes;                        // total HTML written
+    std::vector<std::string> vocabulary; // by decreasing frequency
+    std::vector<std::string> phrases;    // a sample of adjacent word pairs that occur in the pages
+};
+
+// Write a synthetic site in the shape of html_files/ under 'directory':
+// pages sit in a tree of nested subdirN/ directories below index.html, each
+// with a title, a meta description, an <h1> holding the page's path, links
+// and a body of sentences. Links are relative to the page ("file12.html",
+// "subdir4/file9.html", "../../file3.html"). The crawler resolves ".." only
+// within the href (see Search::normalizePath()), so every page is reachable
+// from index.html through links that go down the tree; the other links, up
+// to 'fanout', go to Zipf-popular pages. Words are pronounceable made-up words
+// drawn with Zipf frequencies, capitalized at the start of a sentence. The
+// same options always produce the same bytes: the generator uses its own
+// random number generator rather than the implementation-defined standard
+// distributions. Throws std::runtime_error if a file cannot be written.
+GeneratedSite generateSite(const std::string& directory, const SiteOptions& options);
+
+#endif // SITE_GENERATOR_H
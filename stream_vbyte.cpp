@@ -0,0 +1,153 @@
+#include "stream_vbyte.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define STREAM_VBYTE_X86 1
+#include <immintrin.h>
+#endif
+
+static inline uint8_t lengthCode(uint32_t value)
+{
+    if (value < (1u << 8)) return 0;
+    if (value < (1u << 16)) return 1;
+    if (value < (1u << 24)) return 2;
+    return 3;
+}
+
+size_t streamVByteEncode(const uint32_t* values, size_t count, std::vector<uint8_t>& out)
+{
+    size_t controlBytes = (count + 3) / 4;
+    size_t start = out.size();
+    out.resize(start + controlBytes, 0);
+    for (size_t i = 0; i < count; i++) {
+        uint8_t code = lengthCode(values[i]);
+        out[start + i / 4] |= static_cast<uint8_t>(code << (2 * (i % 4)));
+        uint32_t value = values[i];
+        for (uint8_t b = 0; b <= code; b++) {
+            out.push_back(static_cast<uint8_t>(value >> (8 * b)));
+        }
+    }
+    return out.size() - start;
+}
+
+size_t streamVByteSize(const uint8_t* in, size_t count, size_t available)
+{
+    size_t controlBytes = (count + 3) / 4;
+    if (controlBytes > available) {
+        return SIZE_MAX;
+    }
+    size_t size = controlBytes + count;
+    for (size_t i = 0; i < count / 4; i++) {
+        unsigned control = in[i];
+        size += (control & 3) + ((control >> 2) & 3) + ((control >> 4) & 3) + (control >> 6);
+    }
+    for (size_t i = count & ~static_cast<size_t>(3); i < count; i++) {
+        size += (in[i / 4] >> (2 * (i % 4))) & 3;
+    }
+    return size <= available ? size : SIZE_MAX;
+}
+
+// Decode values [first, count) of a stream whose data for value 'first'
+// starts at 'data'. Returns the end of the data.
+static const uint8_t* decodeScalar(const uint8_t* control, const uint8_t* data, size_t first, size_t count, uint32_t* out)
+{
+    for (size_t i = first; i < count; i++) {
+        unsigned length = ((control[i / 4] >> (2 * (i % 4))) & 3) + 1;
+        uint32_t value = 0;
+        for (unsigned b = 0; b < length; b++) {
+            value |= static_cast<uint32_t>(data[b]) << (8 * b);
+        }
+        out[i] = value;
+        data += length;
+    }
+    return data;
+}
+
+#ifdef STREAM_VBYTE_X86
+
+// Per control byte: the shuffle that spreads its four values' data bytes into
+// four 32-bit lanes, and how many data bytes they take.
+struct ShuffleTable
+{
+    uint8_t masks[256][16];
+    uint8_t lengths[256];
+
+    ShuffleTable()
+    {
+        for (unsigned control = 0; control < 256; control++) {
+            uint8_t next = 0;
+            for (unsigned lane = 0; lane < 4; lane++) {
+                unsigned length = ((control >> (2 * lane)) & 3) + 1;
+                for (unsigned b = 0; b < 4; b++) {
+                    masks[control][4 * lane + b] = b < length ? next++ : 0x80; // 0x80 zeroes the byte
+                }
+            }
+            lengths[control] = next;
+        }
+    }
+};
+
+static const ShuffleTable shuffleTable;
+
+__attribute__((target("ssse3")))
+static void decodeSSSE3(const uint8_t* in, size_t size, size_t count, uint32_t* out)
+{
+    const uint8_t* control = in;
+    const uint8_t* data = in + (count + 3) / 4;
+    const uint8_t* end = in + size;
+    size_t i = 0;
+    // A 16-byte load may only run up to the end of this stream's data.
+    while (i + 4 <= count && end - data >= 16) {
+        uint8_t bits = control[i / 4];
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(shuffleTable.masks[bits]));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_shuffle_epi8(bytes, mask));
+        data += shuffleTable.lengths[bits];
+        i += 4;
+    }
+    decodeScalar(control, data, i, count, out);
+}
+
+// Checked from a static initializer, which may run before libgcc has
+// filled in the CPU model, hence the explicit init.
+static const bool haveSSSE3 = []()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("ssse3") != 0;
+}();
+
+#endif // STREAM_VBYTE_X86
+
+void streamVByteDecode(const uint8_t* in, size_t size, size_t count, uint32_t* out)
+{
+#ifdef STREAM_VBYTE_X86
+    if (haveSSSE3) {
+        decodeSSSE3(in, size, count, out);
+        return;
+    }
+#endif
+    (void)size;
+    decodeScalar(in, in + (count + 3) / 4, 0, count, out);
+}
+
+void prefixSum(uint32_t* values, size_t count, uint32_t base)
+{
+    size_t i = 0;
+#ifdef STREAM_VBYTE_X86
+    // SSE2 is part of x86-64: sum each group of four in two shifted adds,
+    // then carry the group's last sum into the next group.
+    __m128i carry = _mm_set1_epi32(static_cast<int>(base));
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+        v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+        v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+        v = _mm_add_epi32(v, carry);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(values + i), v);
+        carry = _mm_shuffle_epi32(v, 0xFF);
+    }
+    base = static_cast<uint32_t>(_mm_cvtsi128_si32(carry));
+#endif
+    for (; i < count; i++) {
+        base += values[i];
+        values[i] = base;
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef STREAM_VBYTE_H
+#define STREAM_VBYTE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// StreamVByte integer codec. A stream of n values is ceil(n / 4) control
+// bytes followed by the data bytes: every value is stored little-endian in 1
+// to 4 bytes, and each control byte holds the 2-bit length codes of four
+// consecutive values. Keeping the lengths apart from the data lets a decoder
+// expand four values at a time with a single byte shuffle.
+
+// Append the stream of 'count' values to 'out'; returns its size in bytes.
+size_t streamVByteEncode(const uint32_t* values, size_t count, std::vector<uint8_t>& out);
+
+// Size in bytes of the stream of 'count' values starting at 'in', computed
+// from the control bytes alone; 'available' bounds how many bytes may be
+// inspected. Returns SIZE_MAX if the stream would run past 'available'.
+size_t streamVByteSize(const uint8_t* in, size_t count, size_t available);
+
+// Decode the 'count' values of the 'size'-byte stream at 'in' into 'out'.
+// 'size' must be what streamVByteSize() gives; no byte past it is read. Uses
+// SSSE3 when the CPU has it and a scalar loop otherwise.
+void streamVByteDecode(const uint8_t* in, size_t size, size_t count, uint32_t* out);
+
+// Replace deltas by running sums, starting from 'base'.
+void prefixSum(uint32_t* values, size_t count, uint32_t base);
+
+#endif // STREAM_VBYTE_H
@@ -0,0 +1,342 @@
+// Regression check for compressed postings: StreamVByte streams of generated
+// values must decode (with SSSE3 where the CPU has it) to what a plain
+// reading of the format gives, without touching a byte past the stream; and
+// an InvertedIndex over generated documents must give back every posting,
+// position and byte offset, both frozen and after save() and load(), while
+// load() rejects damaged blocks. Exits with status 1 on any failure.
+//
+//   ./stream_vbyte_check.exe [--dir DIR] [--seed X]
+
+#include "inverted_index.h"
+#include "stream_vbyte.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+static size_t failures = 0;
+
+static void expect(bool ok, const std::string& what)
+{
+    if (!ok && failures++ < 10) {
+        std::cout << "FAILED: " << what << std::endl;
+    }
+}
+
+// splitmix64, so the same seed checks the same cases everywhere.
+static uint64_t nextRandom(uint64_t& state)
+{
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// ===================================================
+// CODEC
+// ===================================================
+
+// The format as stream_vbyte.h describes it, one value at a time.
+static std::vector<uint32_t> referenceDecode(const uint8_t* in, size_t count)
+{
+    const uint8_t* data = in + (count + 3) / 4;
+    std::vector<uint32_t> values;
+    for (size_t i = 0; i < count; i++) {
+        size_t length = ((in[i / 4] >> (2 * (i % 4))) & 3) + 1;
+        uint32_t value = 0;
+        for (size_t b = 0; b < length; b++) {
+            value |= static_cast<uint32_t>(*data++) << (8 * b);
+        }
+        values.push_back(value);
+    }
+    return values;
+}
+
+// A value of 1 to 4 bytes, mostly small like postings deltas are.
+static uint32_t randomValue(uint64_t& random, unsigned mix)
+{
+    uint64_t r = nextRandom(random);
+    unsigned width = mix == 4 ? static_cast<unsigned>(r % 4) : mix;
+    switch (width) {
+    case 0: return static_cast<uint32_t>((r >> 8) % 256);
+    case 1: return static_cast<uint32_t>((r >> 8) % 65536);
+    case 2: return static_cast<uint32_t>((r >> 8) % 16777216);
+    default: return static_cast<uint32_t>(r >> 32) | 0x80000000u;
+    }
+}
+
+static void checkCodec(uint64_t& random)
+{
+    // Streams are decoded from the end of a page followed by an inaccessible
+    // one, so reading past the stream faults instead of passing unnoticed.
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    void* mapping = mmap(nullptr, 2 * page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("cannot map a guard page");
+    }
+    uint8_t* guarded = static_cast<uint8_t*>(mapping);
+    mprotect(guarded + page, page, PROT_NONE);
+
+    size_t streams = 0;
+    for (size_t count = 0; count <= 300; count++) {
+        for (unsigned mix = 0; mix <= 4; mix++) {
+            std::vector<uint32_t> values(count);
+            for (uint32_t& value : values) {
+                value = randomValue(random, mix);
+            }
+            if (count > 0 && mix == 4) {
+                values[0] = 0;
+                values[count - 1] = 0xFFFFFFFFu;
+            }
+            std::vector<uint8_t> stream;
+            size_t size = streamVByteEncode(values.data(), count, stream);
+            std::string name = std::to_string(count) + " values, mix " + std::to_string(mix);
+            expect(size == stream.size(), "encoded size of " + name);
+            expect(streamVByteSize(stream.data(), count, stream.size()) == size, "streamVByteSize of " + name);
+            if (size > 0) {
+                expect(streamVByteSize(stream.data(), count, size - 1) == SIZE_MAX, "truncated stream of " + name);
+            }
+            expect(referenceDecode(stream.data(), count) == values, "format of " + name);
+
+            if (size <= page) {
+                uint8_t* in = guarded + page - size;
+                std::memcpy(in, stream.data(), size);
+                std::vector<uint32_t> decoded(count + 1, 0x5A5A5A5Au);
+                streamVByteDecode(in, size, count, decoded.data());
+                expect(std::equal(values.begin(), values.end(), decoded.begin()), "decoding " + name);
+                expect(decoded[count] == 0x5A5A5A5Au, "decoding " + name + " wrote past the output");
+            }
+
+            std::vector<uint32_t> sums(values);
+            uint32_t base = static_cast<uint32_t>(nextRandom(random));
+            prefixSum(sums.data(), count, base);
+            uint32_t running = base;
+            bool sumsOk = true;
+            for (size_t i = 0; i < count; i++) {
+                running += values[i];
+                sumsOk = sumsOk && sums[i] == running;
+            }
+            expect(sumsOk, "prefixSum of " + name);
+            streams++;
+        }
+    }
+    munmap(mapping, 2 * page);
+    std::cout << "Codec: " << streams << " streams checked" << std::endl;
+}
+
+// ===================================================
+// INDEX
+// ===================================================
+
+typedef std::map<std::string, std::vector<Posting> > ReferenceIndex;
+
+// Documents of words from a small vocabulary in mixed case, separated by
+// spaces and punctuation. "the" is in every document, so its list spans
+// several blocks; the others range from common to rare.
+static std::vector<std::string> makeDocuments(uint64_t& random, size_t count)
+{
+    static const char* const separators[] = { " ", " ", " ", ", ", ". ", "-", "\n", "<p>", " (", ") " };
+    std::vector<std::string> documents;
+    for (size_t d = 0; d < count; d++) {
+        std::string text = "The";
+        size_t words = 1 + nextRandom(random) % 200;
+        for (size_t w = 0; w < words; w++) {
+            text += separators[nextRandom(random) % 10];
+            uint64_t r = nextRandom(random);
+            size_t rank = static_cast<size_t>((r % 1000) * (r % 1000) / 2000);
+            std::string word = "w" + std::to_string(rank);
+            if (r & (1ull << 40)) {
+                word[0] = 'W';
+            }
+            text += word;
+        }
+        documents.push_back(text);
+    }
+    return documents;
+}
+
+static ReferenceIndex referenceIndex(const std::vector<std::string>& documents)
+{
+    ReferenceIndex reference;
+    for (DocId doc = 0; doc < documents.size(); doc++) {
+        const std::string& text = documents[doc];
+        uint32_t position = 0;
+        for (size_t i = 0; i < text.size(); ) {
+            if (!std::isalnum(static_cast<unsigned char>(text[i]))) {
+                i++;
+                continue;
+            }
+            size_t start = i;
+            std::string term;
+            for (; i < text.size() && std::isalnum(static_cast<unsigned char>(text[i])); i++) {
+                term += static_cast<char>(std::tolower(static_cast<unsigned char>(text[i])));
+            }
+            std::vector<Posting>& list = reference[term];
+            if (list.empty() || list.back().doc != doc) {
+                list.push_back(Posting());
+                list.back().doc = doc;
+                list.back().tf = 0;
+            }
+            list.back().tf++;
+            list.back().positions.push_back(position++);
+            list.back().offsets.push_back(static_cast<uint32_t>(start));
+        }
+    }
+    return reference;
+}
+
+static void checkIndex(const InvertedIndex& index, const ReferenceIndex& reference, const std::string& stage,
+                       uint64_t& random)
+{
+    expect(index.termCount() == reference.size(), stage + ": term count");
+    size_t postings = 0;
+    for (const auto& entry : reference) {
+        const std::vector<Posting>& expected = entry.second;
+        PostingList list = index.postings(entry.first);
+        expect(list.size() == expected.size(), stage + ": length of " + entry.first);
+        PostingIterator it(list);
+        for (const Posting& posting : expected) {
+            if (it.atEnd() || it.doc() != posting.doc || it.tf() != posting.tf) {
+                expect(false, stage + ": postings of " + entry.first);
+                break;
+            }
+            expect(std::equal(posting.positions.begin(), posting.positions.end(), it.positions()) &&
+                       std::equal(posting.offsets.begin(), posting.offsets.end(), it.offsets()),
+                   stage + ": occurrences of " + entry.first + " in document " + std::to_string(posting.doc));
+            it.next();
+            postings++;
+        }
+        expect(it.atEnd(), stage + ": end of " + entry.first);
+
+        // advance() to targets in increasing order, most of them skipping blocks.
+        PostingIterator cursor(list);
+        DocId target = 0;
+        for (size_t step = 0; step < 8; step++) {
+            target += static_cast<DocId>(nextRandom(random) % 150);
+            std::vector<Posting>::const_iterator first = std::lower_bound(
+                expected.begin(), expected.end(), target, [](const Posting& p, DocId doc) { return p.doc < doc; });
+            bool found = cursor.advance(target);
+            expect(found == (first != expected.end()) && (!found || cursor.doc() == first->doc),
+                   stage + ": advance() in " + entry.first);
+            if (!found) {
+                break;
+            }
+        }
+    }
+    std::cout << stage << ": " << reference.size() << " terms, " << postings << " postings checked" << std::endl;
+}
+
+static std::string readFile(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+// Add 'delta' to the u32 at 'offset' of a section file's payload and store
+// the checksum that makes the damage pass the header check (see the layout
+// in index_file.h), so only the index's own validation can catch it.
+static void damage(const std::string& path, size_t offset, uint32_t delta)
+{
+    const size_t headerSize = 40;
+    const size_t checksumOffset = 24;
+    std::string file = readFile(path);
+    uint32_t value;
+    std::memcpy(&value, &file[headerSize + offset], sizeof(value));
+    value += delta;
+    std::memcpy(&file[headerSize + offset], &value, sizeof(value));
+    Checksum checksum;
+    checksum.update(file.data() + headerSize, file.size() - headerSize);
+    uint64_t sum = checksum.value();
+    std::memcpy(&file[checksumOffset], &sum, sizeof(sum));
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << file;
+}
+
+static bool loads(const std::string& directory, size_t documentCount, uint64_t build)
+{
+    try {
+        InvertedIndex index;
+        index.load(directory, documentCount, build);
+        return true;
+    } catch (const std::runtime_error&) {
+        return false;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string directory = "stream_vbyte_check";
+    uint64_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (arg == "--dir") {
+            directory = value;
+        } else if (arg == "--seed") {
+            seed = std::strtoull(value.c_str(), nullptr, 10);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--dir DIR] [--seed X]" << std::endl;
+            return 1;
+        }
+    }
+
+    try {
+        uint64_t random = seed;
+        checkCodec(random);
+
+        std::vector<std::string> documents = makeDocuments(random, 700);
+        ReferenceIndex reference = referenceIndex(documents);
+        InvertedIndex index;
+        for (DocId doc = 0; doc < documents.size(); doc++) {
+            index.addDocument(doc, documents[doc]);
+        }
+        index.freeze();
+        checkIndex(index, reference, "Frozen index", random);
+
+        const uint64_t build = 42;
+        mkdir(directory.c_str(), 0755);
+        index.save(directory, build);
+        InvertedIndex loaded;
+        loaded.load(directory, documents.size(), build);
+        checkIndex(loaded, reference, "Loaded index", random);
+        expect(!loads(directory, documents.size(), build + 1), "load() of another build");
+
+        // The first block of the first term: its doc stream size, then its
+        // last document (PostingBlock, after the u64 element count).
+        std::string postings = indexFilePath(directory, SECTION_POSTINGS);
+        std::string saved = readFile(postings);
+        damage(postings, 8 + offsetof(PostingBlock, docBytes), 1);
+        expect(!loads(directory, documents.size(), build), "load() of a block with a bad stream size");
+        std::ofstream(postings, std::ios::binary | std::ios::trunc) << saved;
+        damage(postings, 8 + offsetof(PostingBlock, lastDoc), 1);
+        expect(!loads(directory, documents.size(), build), "load() of a block with a bad last document");
+        std::ofstream(postings, std::ios::binary | std::ios::trunc) << saved;
+        expect(loads(directory, documents.size(), build), "load() of the restored index");
+        std::cout << "Damaged index: rejected" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return 1;
+    }
+    if (failures > 0) {
+        std::cout << failures << " failures" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,159 @@
+#include "text_search.h"
+#include <cstdint>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define TEXT_SEARCH_X86 1
+#include <immintrin.h>
+#endif
+
+void foldCase(const char* in, size_t length, char* out)
+{
+    size_t i = 0;
+#ifdef TEXT_SEARCH_X86
+    // Bytes from 0x80 up are negative as signed chars, so they fail the range
+    // test like every other byte outside 'A'..'Z'.
+    const __m128i beforeA = _mm_set1_epi8('A' - 1);
+    const __m128i afterZ = _mm_set1_epi8('Z' + 1);
+    const __m128i caseBit = _mm_set1_epi8(0x20);
+    for (; i + 16 <= length; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(bytes, beforeA), _mm_cmplt_epi8(bytes, afterZ));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_or_si128(bytes, _mm_and_si128(upper, caseBit)));
+    }
+#endif
+    for (; i < length; i++) {
+        char c = in[i];
+        out[i] = (c >= 'A' && c <= 'Z') ? static_cast<char>(c | 0x20) : c;
+    }
+}
+
+std::string foldCase(std::string_view text)
+{
+    std::string folded(text.size(), '\0');
+    foldCase(text.data(), text.size(), &folded[0]);
+    return folded;
+}
+
+static inline bool wholeWordAt(std::string_view text, size_t pos, size_t length)
+{
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(text.data());
+    size_t end = pos + length;
+    return (pos == 0 || !isWordByte(bytes[pos - 1])) && (end >= text.size() || !isWordByte(bytes[end]));
+}
+
+static size_t findScalar(std::string_view text, std::string_view word, size_t from)
+{
+    size_t pos = from;
+    while ((pos = text.find(word, pos)) != std::string::npos) {
+        if (wholeWordAt(text, pos, word.size())) {
+            return pos;
+        }
+        pos++;
+    }
+    return std::string::npos;
+}
+
+#ifdef TEXT_SEARCH_X86
+
+// Checks the candidates of one vector step: bit b of 'mask' is position
+// start + b, where the first and last bytes already matched.
+static inline size_t checkCandidates(std::string_view text, std::string_view word, size_t start, uint32_t mask)
+{
+    while (mask != 0) {
+        size_t pos = start + static_cast<size_t>(__builtin_ctz(mask));
+        if ((word.size() <= 2 || std::memcmp(text.data() + pos + 1, word.data() + 1, word.size() - 2) == 0) &&
+            wholeWordAt(text, pos, word.size())) {
+            return pos;
+        }
+        mask &= mask - 1;
+    }
+    return std::string::npos;
+}
+
+static size_t findSSE2(std::string_view text, std::string_view word, size_t from)
+{
+    const size_t last = word.size() - 1;
+    const __m128i firstByte = _mm_set1_epi8(word[0]);
+    const __m128i lastByte = _mm_set1_epi8(word[last]);
+    size_t i = from;
+    for (; i + last + 16 <= text.size(); i += 16) {
+        __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + i));
+        __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + i + last));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(
+            _mm_and_si128(_mm_cmpeq_epi8(head, firstByte), _mm_cmpeq_epi8(tail, lastByte))));
+        size_t pos = checkCandidates(text, word, i, mask);
+        if (pos != std::string::npos) return pos;
+    }
+    return findScalar(text, word, i);
+}
+
+__attribute__((target("avx2")))
+static size_t findAVX2(std::string_view text, std::string_view word, size_t from)
+{
+    const size_t last = word.size() - 1;
+    const __m256i firstByte = _mm256_set1_epi8(word[0]);
+    const __m256i lastByte = _mm256_set1_epi8(word[last]);
+    size_t i = from;
+    for (; i + last + 32 <= text.size(); i += 32) {
+        __m256i head = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text.data() + i));
+        __m256i tail = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text.data() + i + last));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(
+            _mm256_and_si256(_mm256_cmpeq_epi8(head, firstByte), _mm256_cmpeq_epi8(tail, lastByte))));
+        size_t pos = checkCandidates(text, word, i, mask);
+        if (pos != std::string::npos) return pos;
+    }
+    return findSSE2(text, word, i);
+}
+
+// Checked from a static initializer, which may run before libgcc has
+// filled in the CPU model, hence the explicit init.
+static const bool haveAVX2 = []()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+}();
+
+#endif // TEXT_SEARCH_X86
+
+TextSearchKernel bestTextSearchKernel()
+{
+#ifdef TEXT_SEARCH_X86
+    return haveAVX2 ? KERNEL_AVX2 : KERNEL_SSE2;
+#else
+    return KERNEL_SCALAR;
+#endif
+}
+
+const char* textSearchKernelName(TextSearchKernel kernel)
+{
+    switch (kernel) {
+    case KERNEL_SSE2: return "SSE2";
+    case KERNEL_AVX2: return "AVX2";
+    default: return "scalar";
+    }
+}
+
+size_t findWholeWord(std::string_view text, std::string_view word, size_t from)
+{
+    return findWholeWord(bestTextSearchKernel(), text, word, from);
+}
+
+size_t findWholeWord(TextSearchKernel kernel, std::string_view text, std::string_view word, size_t from)
+{
+    // The empty word keeps find()'s meaning (it occurs at every position).
+    if (word.empty() || from >= text.size()) {
+        return findScalar(text, word, from);
+    }
+#ifdef TEXT_SEARCH_X86
+    if (kernel == KERNEL_AVX2 && haveAVX2) {
+        return findAVX2(text, word, from);
+    }
+    if (kernel != KERNEL_SCALAR) {
+        return findSSE2(text, word, from);
+    }
+#else
+    (void)kernel;
+#endif
+    return findScalar(text, word, from);
+}
@@ -0,0 +1,43 @@
+#ifndef TEXT_SEARCH_H
+#define TEXT_SEARCH_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Case folding and whole-word substring search over document text. Case is
+// folded the way std::tolower() does in the "C" locale the search runs in:
+// only ASCII letters change, so folded text keeps every byte offset. A case-
+// insensitive search is an exact search of the folded word in folded text,
+// which DocumentTable::lowerHtml() keeps for every document.
+
+// Whether a byte is an ASCII letter or digit (std::isalnum() in the "C" locale).
+inline bool isWordByte(unsigned char c)
+{
+    return static_cast<unsigned char>((c | 0x20) - 'a') < 26 || static_cast<unsigned char>(c - '0') < 10;
+}
+
+// Fold 'length' bytes of 'in' into 'out' (which may be 'in'), 16 at a time.
+void foldCase(const char* in, size_t length, char* out);
+std::string foldCase(std::string_view text);
+
+enum TextSearchKernel
+{
+    KERNEL_SCALAR, // std::string_view::find()
+    KERNEL_SSE2,   // 16 candidate positions per step
+    KERNEL_AVX2    // 32 candidate positions per step
+};
+
+// The fastest kernel this CPU runs, and its name.
+TextSearchKernel bestTextSearchKernel();
+const char* textSearchKernelName(TextSearchKernel kernel);
+
+// Position of the first occurrence of 'word' in 'text' at or after 'from'
+// whose neighbouring bytes are not letters or digits, or std::string::npos.
+// Bytes are compared exactly. The vector kernels test a whole register of
+// candidate positions at once against the word's first and last bytes and
+// only compare the rest of the word where both match.
+size_t findWholeWord(std::string_view text, std::string_view word, size_t from = 0);
+size_t findWholeWord(TextSearchKernel kernel, std::string_view text, std::string_view word, size_t from = 0);
+
+#endif // TEXT_SEARCH_H
@@ -0,0 +1,122 @@
+// Text search microbenchmark: loads a saved index (--build-index) and times
+// a case-insensitive whole-word search of every page for each word, the way
+// findWord() used to do it (fold a copy of the page, then find()) against
+// findWholeWord() over the pages' lowercase shadows with each kernel.
+//
+//   ./text_search_bench.exe INDEX_DIR [--repeat R] [WORD...]
+
+#include "document_table.h"
+#include "text_search.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// findWord() before the lowercase shadow: a folded copy of the page per call.
+static size_t copyAndFind(std::string_view text, const std::string& word)
+{
+    std::string lowerText(text);
+    std::string lowerWord = word;
+    std::transform(lowerText.begin(), lowerText.end(), lowerText.begin(), ::tolower);
+    std::transform(lowerWord.begin(), lowerWord.end(), lowerWord.begin(), ::tolower);
+    size_t pos = 0;
+    while ((pos = lowerText.find(lowerWord, pos)) != std::string::npos) {
+        bool validBefore = pos == 0 || !std::isalnum(static_cast<unsigned char>(lowerText[pos - 1]));
+        size_t afterPos = pos + lowerWord.size();
+        bool validAfter = afterPos >= lowerText.size() || !std::isalnum(static_cast<unsigned char>(lowerText[afterPos]));
+        if (validBefore && validAfter) {
+            return pos;
+        }
+        pos++;
+    }
+    return std::string::npos;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <index_dir> [--repeat R] [word...]" << std::endl;
+        return 1;
+    }
+    unsigned repeat = 5;
+    std::vector<std::string> words;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--repeat" && i + 1 < argc) {
+            repeat = static_cast<unsigned>(std::max(1, std::atoi(argv[++i])));
+        } else {
+            words.push_back(arg);
+        }
+    }
+    if (words.empty()) {
+        words = {"the", "search", "html", "zyzzyva"};
+    }
+
+    try {
+        DocumentTable documents;
+        documents.load(argv[1]);
+        size_t bytes = 0;
+        for (DocId doc = 0; doc < documents.size(); doc++) {
+            bytes += documents.html(doc).size();
+        }
+        if (bytes == 0) {
+            std::cerr << "Empty index" << std::endl;
+            return 1;
+        }
+        std::cout << std::fixed << std::setprecision(1);
+        std::cout << "Pages: " << documents.size() << ", " << static_cast<double>(bytes) / documents.size()
+                  << " bytes on average; best kernel: " << textSearchKernelName(bestTextSearchKernel()) << std::endl;
+
+        std::vector<TextSearchKernel> kernels = {KERNEL_SCALAR};
+        if (bestTextSearchKernel() != KERNEL_SCALAR) kernels.push_back(KERNEL_SSE2);
+        if (bestTextSearchKernel() == KERNEL_AVX2) kernels.push_back(KERNEL_AVX2);
+
+        for (const std::string& word : words) {
+            // Best of 'repeat' runs; every method must find the same positions.
+            std::string lowerWord = foldCase(word);
+            std::vector<size_t> expected(documents.size());
+            double copySeconds = 1e300;
+            for (unsigned r = 0; r < repeat; r++) {
+                Clock::time_point start = Clock::now();
+                for (DocId doc = 0; doc < documents.size(); doc++) {
+                    expected[doc] = copyAndFind(documents.html(doc), word);
+                }
+                copySeconds = std::min(copySeconds, secondsSince(start));
+            }
+            size_t found = documents.size() - std::count(expected.begin(), expected.end(), std::string::npos);
+            std::cout << "\"" << word << "\" (on " << found << " pages): copy + find "
+                      << bytes / copySeconds / 1e6 << " MB/s";
+
+            for (TextSearchKernel kernel : kernels) {
+                double seconds = 1e300;
+                for (unsigned r = 0; r < repeat; r++) {
+                    Clock::time_point start = Clock::now();
+                    for (DocId doc = 0; doc < documents.size(); doc++) {
+                        if (findWholeWord(kernel, documents.lowerHtml(doc), lowerWord) != expected[doc]) {
+                            throw std::runtime_error(std::string(textSearchKernelName(kernel)) + " kernel disagrees on \"" + word + "\"");
+                        }
+                    }
+                    seconds = std::min(seconds, secondsSince(start));
+                }
+                std::cout << ", " << textSearchKernelName(kernel) << " " << bytes / seconds / 1e6 << " MB/s";
+            }
+            std::cout << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
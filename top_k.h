@@ -0,0 +1,65 @@
+#ifndef TOP_K_H
+#define TOP_K_H
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <vector>
+#include "inverted_index.h"
+
+// Search results are ranked by score, highest first; documents with equal
+// scores are ranked by DocId (URL order), so the first K of a full ranking
+// and a top-K ranking are always the same list.
+inline bool rankedBefore(const std::pair<DocId, double>& a, const std::pair<DocId, double>& b)
+{
+    if (a.second != b.second) return a.second > b.second;
+    return a.first < b.first;
+}
+
+// Collects the K best results of a query (every result when K is 0). The kept
+// results are a heap with the worst of them on top, so a document only costs
+// a comparison once the heap is full. Documents must be offered in increasing
+// DocId order: a later document then has to beat the worst kept score outright
+// to get in, which is what admits() checks against a score upper bound.
+class TopKResults
+{
+public:
+    explicit TopKResults(size_t k) : k(k) {}
+
+    bool full() const { return k != 0 && kept.size() >= k; }
+
+    // Lowest score a new document has to beat, or -infinity while not full.
+    double threshold() const
+    {
+        return full() ? kept.front().second : -std::numeric_limits<double>::infinity();
+    }
+
+    // False if a document whose score is at most 'bound' cannot be kept.
+    bool admits(double bound) const { return !full() || bound > threshold(); }
+
+    void add(DocId doc, double score)
+    {
+        std::pair<DocId, double> result(doc, score);
+        if (!full()) {
+            kept.push_back(result);
+            if (k != 0) std::push_heap(kept.begin(), kept.end(), rankedBefore);
+        } else if (rankedBefore(result, kept.front())) {
+            std::pop_heap(kept.begin(), kept.end(), rankedBefore);
+            kept.back() = result;
+            std::push_heap(kept.begin(), kept.end(), rankedBefore);
+        }
+    }
+
+    // The kept results, best first.
+    std::vector<std::pair<DocId, double> > take()
+    {
+        std::sort(kept.begin(), kept.end(), rankedBefore);
+        return std::move(kept);
+    }
+
+private:
+    size_t k;
+    std::vector<std::pair<DocId, double> > kept;
+};
+
+#endif // TOP_K_H
@@ -0,0 +1,181 @@
+#include "trace.h"
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+std::atomic<bool> traceEnabled(false);
+
+namespace
+{
+
+struct TraceEvent
+{
+    const char* name;
+    const char* argName;
+    std::string argText;
+    uint64_t argNumber;
+    bool numeric;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point end;
+};
+
+// Events are written by the owning thread only: an event is filled in first
+// and then made visible by raising 'count', and a full chunk is linked to the
+// next one before that one is used, so readers need no lock.
+struct TraceChunk
+{
+    static const size_t CAPACITY = 1024;
+
+    TraceChunk() : count(0), next(nullptr) {}
+
+    TraceEvent events[CAPACITY];
+    std::atomic<size_t> count;
+    std::atomic<TraceChunk*> next;
+};
+
+struct TraceBuffer
+{
+    explicit TraceBuffer(unsigned id) : threadId(id), head(new TraceChunk()), tail(head) {}
+
+    void append(TraceEvent& event)
+    {
+        size_t used = tail->count.load(std::memory_order_relaxed);
+        if (used == TraceChunk::CAPACITY) {
+            TraceChunk* chunk = new TraceChunk();
+            tail->next.store(chunk, std::memory_order_release);
+            tail = chunk;
+            used = 0;
+        }
+        tail->events[used] = std::move(event);
+        tail->count.store(used + 1, std::memory_order_release);
+    }
+
+    unsigned threadId;
+    TraceChunk* head;
+    TraceChunk* tail; // owner only
+};
+
+// Buffers outlive their threads (crawl and query workers finish before the
+// trace is written), so they are owned here and never freed.
+struct TraceRegistry
+{
+    std::mutex lock;
+    std::vector<TraceBuffer*> buffers;
+    std::chrono::steady_clock::time_point origin;
+};
+
+TraceRegistry& registry()
+{
+    static TraceRegistry* instance = new TraceRegistry();
+    return *instance;
+}
+
+TraceBuffer& localBuffer()
+{
+    static thread_local TraceBuffer* buffer = nullptr;
+    if (buffer == nullptr) {
+        TraceRegistry& trace = registry();
+        std::lock_guard<std::mutex> guard(trace.lock);
+        buffer = new TraceBuffer(static_cast<unsigned>(trace.buffers.size() + 1));
+        trace.buffers.push_back(buffer);
+    }
+    return *buffer;
+}
+
+void writeJsonString(std::ostream& out, const std::string& text)
+{
+    out << '"';
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (c < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out << escaped;
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+double microseconds(std::chrono::steady_clock::duration duration)
+{
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+} // namespace
+
+void startTracing()
+{
+    TraceRegistry& trace = registry();
+    {
+        std::lock_guard<std::mutex> guard(trace.lock);
+        trace.origin = std::chrono::steady_clock::now();
+    }
+    traceEnabled.store(true, std::memory_order_release);
+}
+
+void TraceSpan::finish()
+{
+    TraceEvent event;
+    event.name = name;
+    event.argName = argName;
+    event.argText.swap(argText);
+    event.argNumber = argNumber;
+    event.numeric = numeric;
+    event.start = start;
+    event.end = std::chrono::steady_clock::now();
+    localBuffer().append(event);
+}
+
+void writeTrace(const std::string& path)
+{
+    TraceRegistry& trace = registry();
+    std::vector<TraceBuffer*> buffers;
+    std::chrono::steady_clock::time_point origin;
+    {
+        std::lock_guard<std::mutex> guard(trace.lock);
+        buffers = trace.buffers;
+        origin = trace.origin;
+    }
+
+    std::ostringstream out;
+    out.setf(std::ios::fixed);
+    out.precision(3);
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first = true;
+    for (const TraceBuffer* buffer : buffers) {
+        for (const TraceChunk* chunk = buffer->head; chunk != nullptr; chunk = chunk->next.load(std::memory_order_acquire)) {
+            size_t count = chunk->count.load(std::memory_order_acquire);
+            for (size_t i = 0; i < count; i++) {
+                const TraceEvent& event = chunk->events[i];
+                out << (first ? "" : ",\n") << "{\"name\": \"" << event.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+                    << buffer->threadId << ", \"ts\": " << microseconds(event.start - origin)
+                    << ", \"dur\": " << microseconds(event.end - event.start);
+                if (event.argName != nullptr) {
+                    out << ", \"args\": {\"" << event.argName << "\": ";
+                    if (event.numeric) {
+                        out << event.argNumber;
+                    } else {
+                        writeJsonString(out, event.argText);
+                    }
+                    out << "}";
+                }
+                out << "}";
+                first = false;
+            }
+        }
+    }
+    out << "\n]}\n";
+
+    std::ofstream file(path);
+    file << out.str();
+    file.close();
+    if (!file) {
+        throw std::runtime_error("cannot write trace to " + path);
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Opt-in span tracing for --trace, written in the Chrome trace-event JSON
+// format (chrome://tracing, Perfetto). A TraceSpan records a complete event
+// on the calling thread when it goes out of scope; spans on one thread nest
+// by time, so a query shows up as a tree of its phases. Each thread appends
+// to its own buffer of fixed-size chunks and publishes every event with a
+// release store, so recording takes no lock, and writeTrace() can read the
+// buffers of threads that are still running. While tracing is off a span
+// costs one relaxed load.
+
+// Start recording spans; timestamps in the trace count from this call.
+void startTracing();
+
+// Write every span recorded so far to 'path'. Throws std::runtime_error if
+// the file cannot be written.
+void writeTrace(const std::string& path);
+
+extern std::atomic<bool> traceEnabled;
+
+inline bool tracingEnabled()
+{
+    return traceEnabled.load(std::memory_order_relaxed);
+}
+
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char* name) : name(name), argName(nullptr), argNumber(0), numeric(false)
+    {
+        begin();
+    }
+    TraceSpan(const char* name, const char* argName, uint64_t value)
+        : name(name), argName(argName), argNumber(value), numeric(true)
+    {
+        begin();
+    }
+    TraceSpan(const char* name, const char* argName, std::string_view value)
+        : name(name), argName(argName), argNumber(0), numeric(false)
+    {
+        if (begin()) {
+            argText.assign(value.data(), value.size());
+        }
+    }
+    ~TraceSpan()
+    {
+        if (name != nullptr) {
+            finish();
+        }
+    }
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    bool begin()
+    {
+        if (!tracingEnabled()) {
+            name = nullptr;
+            return false;
+        }
+        start = std::chrono::steady_clock::now();
+        return true;
+    }
+    void finish();
+
+    const char* name; // nullptr when tracing was off at construction
+    const char* argName;
+    std::string argText;
+    uint64_t argNumber;
+    bool numeric;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif // TRACE_H
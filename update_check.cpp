@@ -0,0 +1,232 @@
+// Check for --update-index: generates a synthetic site (site_generator.h) and
+// saves its index, then for a few rounds edits, touches, deletes and adds
+// pages, updates the saved index with Search::updateIndex() and compares it
+// byte for byte with the index a fresh crawl of the same tree saves.
+// Reports the time of both and exits with status 1 on any difference.
+//
+//   ./update_check.exe [--dir DIR] [--pages N] [--rounds R] [--changes C]
+//                      [--seed X] [--threads T]
+
+#include "search.h"
+#include "site_generator.h"
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// splitmix64, so the same seed makes the same edits everywhere.
+static uint64_t nextRandom(uint64_t& state)
+{
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Every .html file below 'directory' except the site's index.html, sorted.
+static void listPages(const std::string& directory, bool root, std::vector<std::string>& pages)
+{
+    DIR* dir = opendir(directory.c_str());
+    if (dir == nullptr) {
+        throw std::runtime_error("cannot list " + directory);
+    }
+    while (struct dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..") {
+            continue;
+        }
+        std::string path = directory + "/" + name;
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) {
+            continue;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            listPages(path, false, pages);
+        } else if (name.size() > 5 && name.compare(name.size() - 5, 5, ".html") == 0 && !(root && name == "index.html")) {
+            pages.push_back(path);
+        }
+    }
+    closedir(dir);
+    if (root) {
+        std::sort(pages.begin(), pages.end());
+    }
+}
+
+static std::string readFile(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+static void writeFile(const std::string& path, const std::string& contents)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << contents;
+    if (!out) {
+        throw std::runtime_error("cannot write " + path);
+    }
+}
+
+// One round of changes to the site under 'root': 'changes' pages get a
+// sentence appended and as many are touched without changing; a quarter as
+// many are deleted, and as many lose their links (which can cut off whole
+// subtrees); and a new page is linked from index.html.
+static void changeSite(const std::string& root, size_t changes, unsigned round, uint64_t& random)
+{
+    std::vector<std::string> pages;
+    listPages(root, true, pages);
+    // A random prefix of the pages, each picked once.
+    size_t picks = std::min(pages.size(), 2 * changes + 2 * (changes / 4));
+    for (size_t i = 0; i < picks; i++) {
+        std::swap(pages[i], pages[i + nextRandom(random) % (pages.size() - i)]);
+    }
+    size_t next = 0;
+
+    for (size_t i = 0; i < changes && next < picks; i++, next++) {
+        std::string html = readFile(pages[next]);
+        size_t body = html.rfind("</body>");
+        html.insert(body == std::string::npos ? html.size() : body, "<p>Edited in round " + std::to_string(round) + ".</p>\n");
+        writeFile(pages[next], html);
+    }
+    for (size_t i = 0; i < changes && next < picks; i++, next++) {
+        // Move the modification time a second ahead; the contents stay.
+        struct stat st;
+        if (stat(pages[next].c_str(), &st) == 0) {
+            struct timespec times[2] = { st.st_atim, st.st_mtim };
+            times[1].tv_sec += 1;
+            utimensat(AT_FDCWD, pages[next].c_str(), times, 0);
+        }
+    }
+    for (size_t i = 0; i < changes / 4 && next < picks; i++, next++) {
+        std::remove(pages[next].c_str());
+    }
+    for (size_t i = 0; i < changes / 4 && next < picks; i++, next++) {
+        writeFile(pages[next], "<html><head><title>Emptied</title></head><body><p>Nothing left here.</p></body></html>\n");
+    }
+
+    std::string name = "added" + std::to_string(round) + ".html";
+    writeFile(root + "/" + name, "<html><head><title>Added in round " + std::to_string(round) +
+                                     "</title></head><body><p>A new page.</p><a href=\"index.html\">home</a></body></html>\n");
+    std::string index = readFile(root + "/index.html");
+    size_t body = index.rfind("</body>");
+    index.insert(body == std::string::npos ? index.size() : body, "<a href=\"" + name + "\">new</a>\n");
+    writeFile(root + "/index.html", index);
+}
+
+int main(int argc, char** argv)
+{
+    SiteOptions options;
+    std::string directory = "check_site";
+    unsigned rounds = 3;
+    size_t changes = 20;
+    unsigned threads = 1;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (arg == "--dir") {
+            directory = value;
+        } else if (arg == "--pages") {
+            options.pages = std::strtoul(value.c_str(), nullptr, 10);
+        } else if (arg == "--rounds") {
+            rounds = static_cast<unsigned>(std::max(1, std::atoi(value.c_str())));
+        } else if (arg == "--changes") {
+            changes = std::strtoul(value.c_str(), nullptr, 10);
+        } else if (arg == "--seed") {
+            options.seed = std::strtoull(value.c_str(), nullptr, 10);
+        } else if (arg == "--threads") {
+            threads = static_cast<unsigned>(std::max(1, std::atoi(value.c_str())));
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--dir DIR] [--pages N] [--rounds R] [--changes C] [--seed X]"
+                      << " [--threads T]" << std::endl;
+            return 1;
+        }
+    }
+
+    bool identical = true;
+    try {
+        std::cout << std::fixed << std::setprecision(2);
+
+        // Generating the site again undoes an earlier run's edits (pages it
+        // added are no longer linked).
+        std::string site = directory + "/site";
+        std::string updated = directory + "/updated";
+        std::string fresh = directory + "/fresh";
+        mkdir(directory.c_str(), 0755);
+        GeneratedSite generated = generateSite(site, options);
+        std::cout << "Generate: " << generated.pages << " pages, " << generated.bytes / 1e6 << " MB" << std::endl;
+
+        {
+            Search engine;
+            engine.crawl(generated.seedPath, threads);
+            engine.saveIndex(updated);
+        }
+
+        uint64_t random = options.seed;
+        for (unsigned round = 1; round <= rounds; round++) {
+            changeSite(site, changes, round, random);
+
+            Search engine;
+            Clock::time_point start = Clock::now();
+            RecrawlStats stats = engine.updateIndex(generated.seedPath, updated, threads);
+            engine.saveIndex(updated);
+            double updateSeconds = secondsSince(start);
+
+            Search reference;
+            start = Clock::now();
+            reference.crawl(generated.seedPath, threads);
+            reference.saveIndex(fresh);
+            double buildSeconds = secondsSince(start);
+
+            std::vector<std::string> differing;
+            for (int section = SECTION_TERMS; section <= SECTION_CRAWL; section++) {
+                std::string name = indexFilePath("", static_cast<IndexSection>(section)).substr(1);
+                if (readFile(updated + "/" + name) != readFile(fresh + "/" + name)) {
+                    differing.push_back(name);
+                }
+            }
+            std::cout << "Round " << round << ": " << stats.unchanged << " unchanged, " << stats.changed << " changed, "
+                      << stats.added << " added, " << stats.removed << " removed; update " << updateSeconds
+                      << " s, full build " << buildSeconds << " s; ";
+            if (!stats.incremental) {
+                std::cout << "NOT INCREMENTAL" << std::endl;
+                identical = false;
+            } else if (!differing.empty()) {
+                std::cout << "DIFFERS:";
+                for (const std::string& name : differing) {
+                    std::cout << " " << name;
+                }
+                std::cout << std::endl;
+                identical = false;
+            } else {
+                std::cout << "identical" << std::endl;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Exception: " << e.what() << std::endl;
+        return 1;
+    }
+    return identical ? 0 : 1;
+}
@@ -0,0 +1,64 @@
+#include "worker_pool.h"
+#include <algorithm>
+#include <exception>
+#include <iostream>
+
+WorkerPool::WorkerPool(unsigned threads) : running(0), stopping(false)
+{
+    for (unsigned i = 0; i < std::max(1u, threads); i++) {
+        workers.push_back(std::thread(&WorkerPool::run, this));
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    ready.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void WorkerPool::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        tasks.push_back(std::move(task));
+    }
+    ready.notify_one();
+}
+
+void WorkerPool::wait()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    idle.wait(guard, [this]() { return tasks.empty() && running == 0; });
+}
+
+void WorkerPool::run()
+{
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            ready.wait(guard, [this]() { return stopping || !tasks.empty(); });
+            if (tasks.empty()) {
+                return; // stopping, and nothing left to run
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+            running++;
+        }
+        try {
+            task();
+        } catch (const std::exception& e) {
+            std::cerr << "Exception: " << e.what() << std::endl;
+        }
+        std::lock_guard<std::mutex> guard(lock);
+        if (--running == 0 && tasks.empty()) {
+            idle.notify_all();
+        }
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads running submitted tasks, oldest first. The destructor
+// runs every task still queued and then joins the threads. A task that throws
+// is reported on stderr; the worker keeps going.
+class WorkerPool
+{
+public:
+    explicit WorkerPool(unsigned threads);
+    ~WorkerPool();
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void submit(std::function<void()> task);
+
+    // Block until every submitted task has finished.
+    void wait();
+    size_t size() const { return workers.size(); }
+
+private:
+    void run();
+
+    std::mutex lock;
+    std::condition_variable ready;
+    std::condition_variable idle;
+    std::deque<std::function<void()> > tasks;
+    size_t running; // tasks taken off the queue but not finished
+    bool stopping;
+    std::vector<std::thread> workers;
+};
+
+#endif // WORKER_POOL_H